@@ -4,10 +4,6 @@ in vec2 uv_coordinate;
 
 uniform sampler2D my_texture;
 
-uniform vec3 bottomLeft;
-uniform float clothWidth;
-uniform float clothDepth;
-
 out vec4 fragColor;
 
 
@@ -6,16 +6,18 @@ out vec3 worldSpacePosition;
 out vec2 uv_coordinate;
 
 
-uniform mat4 inverseModelMatrix;
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projMatrix;
+//cloth positions and normals are already in world space
+layout(std140) uniform Camera {
+    mat4 viewMatrix;
+    mat4 projMatrix;
+    mat4 viewProjMatrix;
+};
 
 void main() {
 
-    worldSpacePosition = vec3(modelMatrix * vec4(objectSpacePosition, 1.0));
+    worldSpacePosition = objectSpacePosition;
 
-    gl_Position = projMatrix * viewMatrix * modelMatrix * vec4(objectSpacePosition, 1.0);
+    gl_Position = viewProjMatrix * vec4(objectSpacePosition, 1.0);
 
     uv_coordinate = vec2(uv);
 
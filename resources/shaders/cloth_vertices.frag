@@ -1,16 +1,25 @@
 #version 330 core
 in vec3 worldSpacePosition;
-in vec3 springColor;
 
 out vec4 fragColor;
 
+//set while drawing springs, each line looks up the type of its spring by primitive index
+uniform bool colorBySpringType;
+uniform usamplerBuffer springTypes;
+
 
 void main() {
     fragColor = vec4(1.0, 1.0, 1.0, 1.0);
-    if (springColor == vec3(0, 0, 0)) {
-        fragColor = vec4(1.0, 1.0, 1.0, 1.0);
-    }
-    else {
-        fragColor = vec4(springColor, 1.0);
+    if (colorBySpringType) {
+        uint type = texelFetch(springTypes, gl_PrimitiveID).r;
+        if (type == 0u) {
+            fragColor = vec4(1.0, 0.0, 0.0, 1.0); //structural, red
+        }
+        else if (type == 1u) {
+            fragColor = vec4(0.0, 1.0, 0.0, 1.0); //shear, green
+        }
+        else {
+            fragColor = vec4(0.0, 0.0, 1.0, 1.0); //bend, blue
+        }
     }
 }
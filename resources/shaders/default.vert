@@ -1,9 +1,15 @@
 #version 330 core
 
-layout(location = 0) in vec3 aPos;
+layout(location = 0) in vec4 aAnchor;   // center and radius, radius 0 for bone endpoints
+layout(location = 1) in vec2 aOffset;   // point on the unit circle in the x-y plane
 
-uniform mat4 uVP;   // view-projection matrix
+layout(std140) uniform Camera {
+    mat4 viewMatrix;
+    mat4 projMatrix;
+    mat4 viewProjMatrix;
+};
 
 void main() {
-    gl_Position = uVP * vec4(aPos, 1.0);
+    vec3 pos = aAnchor.xyz + aAnchor.w * vec3(aOffset, 0.0);
+    gl_Position = viewProjMatrix * vec4(pos, 1.0);
 }
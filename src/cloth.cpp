@@ -1,42 +1,85 @@
 #include "cloth.h"
 #include "settings.h"
+#include "threadpool.h"
 #include <GL/glew.h>
 #include "iostream"
+#include <algorithm>
+#include <limits>
 
 
-Cloth::Cloth(float w, float d, float wStep, float dStep, float h, glm::vec3 bottomLeft)
-    : width(w), depth(d), widthStep(wStep), depthStep(dStep), height(h), bottomLeftPos(bottomLeft) {
+Cloth::Cloth(const ClothDescriptor &clothDescriptor)
+    : descriptor(clothDescriptor) {
 
     sphereTop = glm::vec3(0.f);
 
+    m_widthPoints = static_cast<int>(descriptor.width / descriptor.widthStep) + 1;
+    m_depthPoints = static_cast<int>(descriptor.depth / descriptor.depthStep) + 1;
+
     m_triangleIndices = std::vector<GLuint>();
     createVertices();
     createSprings();
+    colorSprings();
+    buildAdjacency();
+    buildTiles();
     setTriangleIndices();
+    buildVertexTriangles();
+    buildEdges();
+    m_triangleBVH.build(m_triangleIndices, m_positions);
     setNormals();
 };
 
 
 void Cloth::createVertices() {
-    int widthPoints = static_cast<int>(width / widthStep) + 1;
-    int depthPoints = static_cast<int>(depth / depthStep) + 1;
+    int widthPoints = m_widthPoints;
+    int depthPoints = m_depthPoints;
+
+    int vertexCount = widthPoints * depthPoints;
+
+    m_positions.reserve(vertexCount);
+    m_uvs.reserve(vertexCount);
 
     for (int i = 0; i < widthPoints; i++) {
         for (int j = 0; j < depthPoints; j++) {
 
-            glm::vec3 position = bottomLeftPos + glm::vec3(i * widthStep, height, j * depthStep);
-            Vertex v;
+            glm::vec3 position = descriptor.origin + glm::vec3(i * descriptor.widthStep, 0.f, j * descriptor.depthStep);
 
-            v = {position, position, 5.0f, false, glm::vec3(0.f,0.f,0.f), glm::vec2(float(i) / float(widthPoints - 1), float(j) / float(depthPoints - 1)), glm::vec3(0.f,0.f,0.f), settings.clothVertexRadius, {}}; //uncomment to unanchor all vertices
-
-            m_vertices.push_back(v);
+            m_positions.push_back(position);
+            m_uvs.push_back(glm::vec2(float(i) / float(widthPoints - 1), float(j) / float(depthPoints - 1)));
         }
     }
+
+    m_prevPositions = m_positions;
+    m_lastStepPositions = m_positions;
+    m_renderPositions = m_positions;
+    m_invMasses.assign(vertexCount, 1.f / 5.0f); //every vertex has mass 5
+    m_flags.assign(vertexCount, 0); //no vertex starts anchored
+    m_contactForces.assign(vertexCount, glm::vec3(0.f));
+    m_normals.assign(vertexCount, glm::vec3(0.f));
+
+    m_forces.assign(vertexCount, glm::vec3(0.f));
+    m_iteratePositions.assign(vertexCount, glm::vec3(0.f));
+    m_previousIteratePositions.assign(vertexCount, glm::vec3(0.f));
+    m_selfCollisionHash.reserve(vertexCount);
 }
 
 void Cloth::createSprings() {
-    int widthPoints = static_cast<int>(width / widthStep) + 1;
-    int depthPoints = static_cast<int>(depth / depthStep) + 1;
+    int widthPoints = m_widthPoints;
+    int depthPoints = m_depthPoints;
+
+    const float structuralK = descriptor.structuralK;
+    const float shearK = descriptor.shearK;
+    const float bendK = descriptor.bendK;
+    const float damping = descriptor.damping;
+
+    //xpbd compliance follows the same stiffness the mass spring solver uses
+    float structuralCompliance = descriptor.xpbdComplianceScale / std::max(structuralK, 1e-6f);
+    float shearCompliance = descriptor.xpbdComplianceScale / std::max(shearK, 1e-6f);
+    float bendCompliance = descriptor.xpbdComplianceScale / std::max(bendK, 1e-6f);
+
+    //exact count: structural + shear + bend springs
+    m_springs.reserve((widthPoints-1)*depthPoints + widthPoints*(depthPoints-1)
+                      + 2*(widthPoints-1)*(depthPoints-1)
+                      + std::max(widthPoints-2, 0)*depthPoints + widthPoints*std::max(depthPoints-2, 0));
 
     for (int i = 0; i < widthPoints; i++) {
         for (int j = 0; j < depthPoints; j++) {
@@ -48,35 +91,27 @@ void Cloth::createSprings() {
 
             if (i < widthPoints - 1) { //vertex not on the right edge of cloth
                 int rightNeighbor = (i+1) * depthPoints + j; //traveling down x axis towards +x
-                float restLen = glm::length(m_vertices[rightNeighbor].pos - m_vertices[current].pos);
-                m_springs.push_back({current, rightNeighbor, settings.structuralK, settings.damping, SpringType::STRUCTURAL, restLen});
-                m_vertices[current].neighbors.push_back(rightNeighbor);
-                m_vertices[rightNeighbor].neighbors.push_back(current);
+                float restLen = glm::length(m_positions[rightNeighbor] - m_positions[current]);
+                m_springs.push_back({current, rightNeighbor, structuralK, damping, SpringType::STRUCTURAL, restLen, structuralCompliance, 0.f});
             }
 
             if (j < depthPoints - 1) { //vertex not on the top edge of cloth
                 int topNeighbor = i * depthPoints + (j+1); //traveling down z axis towards -z
-                float restLen = glm::length(m_vertices[topNeighbor].pos - m_vertices[current].pos);
-                m_springs.push_back({current, topNeighbor, settings.structuralK, settings.damping, SpringType::STRUCTURAL, restLen});
-                m_vertices[current].neighbors.push_back(topNeighbor);
-                m_vertices[topNeighbor].neighbors.push_back(current);
+                float restLen = glm::length(m_positions[topNeighbor] - m_positions[current]);
+                m_springs.push_back({current, topNeighbor, structuralK, damping, SpringType::STRUCTURAL, restLen, structuralCompliance, 0.f});
             }
 
 
             //each vertex has 2 shear springs
             if (i < widthPoints - 1 && j < depthPoints - 1) { //vertex not on right edge or top edge of cloth
                 int topDiagonal = (i+1) * depthPoints + (j+1);
-                float restLen = glm::length(m_vertices[topDiagonal].pos - m_vertices[current].pos);
-                m_springs.push_back({current, topDiagonal, settings.shearK, settings.damping, SpringType::SHEAR, restLen});
-                m_vertices[current].neighbors.push_back(topDiagonal);
-                m_vertices[topDiagonal].neighbors.push_back(current);
+                float restLen = glm::length(m_positions[topDiagonal] - m_positions[current]);
+                m_springs.push_back({current, topDiagonal, shearK, damping, SpringType::SHEAR, restLen, shearCompliance, 0.f});
             }
             if (i < widthPoints - 1 && j > 0) { //vertex not on right edge or bottom edge of cloth
                 int bottomDiagonal = (i+1) * depthPoints + (j-1);
-                float restLen = glm::length(m_vertices[bottomDiagonal].pos - m_vertices[current].pos);
-                m_springs.push_back({current, bottomDiagonal, settings.shearK, settings.damping, SpringType::SHEAR, restLen});
-                m_vertices[current].neighbors.push_back(bottomDiagonal);
-                m_vertices[bottomDiagonal].neighbors.push_back(current);
+                float restLen = glm::length(m_positions[bottomDiagonal] - m_positions[current]);
+                m_springs.push_back({current, bottomDiagonal, shearK, damping, SpringType::SHEAR, restLen, shearCompliance, 0.f});
             }
 
 
@@ -84,28 +119,158 @@ void Cloth::createSprings() {
             //dont double count! only put right and top
             if (i < widthPoints - 2) { //vertex not on the right edge of cloth
                 int rightNeighbor = (i+2) * depthPoints + j; //traveling down x axis towards +x
-                float restLen = glm::length(m_vertices[rightNeighbor].pos - m_vertices[current].pos);
-                m_springs.push_back({current, rightNeighbor, settings.bendK, settings.damping, SpringType::BEND, restLen});
-                m_vertices[current].neighbors.push_back(rightNeighbor);
-                m_vertices[rightNeighbor].neighbors.push_back(current);
+                float restLen = glm::length(m_positions[rightNeighbor] - m_positions[current]);
+                m_springs.push_back({current, rightNeighbor, bendK, damping, SpringType::BEND, restLen, bendCompliance, 0.f});
             }
             if (j < depthPoints - 2) { //vertex not on the top edge of cloth
                 int topNeighbor = i * depthPoints + (j+2); //traveling down z axis towards -z
-                float restLen = glm::length(m_vertices[topNeighbor].pos - m_vertices[current].pos);
-                m_springs.push_back({current, topNeighbor, settings.bendK, settings.damping, SpringType::BEND, restLen});
-                m_vertices[current].neighbors.push_back(topNeighbor);
-                m_vertices[topNeighbor].neighbors.push_back(current);
+                float restLen = glm::length(m_positions[topNeighbor] - m_positions[current]);
+                m_springs.push_back({current, topNeighbor, bendK, damping, SpringType::BEND, restLen, bendCompliance, 0.f});
+            }
+        }
+    }
+}
+
+
+//fixed palette from the grid offset of the spring and the parity of its first vertex
+//springs of one kind only share vertices with the next one along their own row or column
+int Cloth::springColor(const Spring &s) const {
+    int i = s.vertexOne / m_depthPoints;
+    int j = s.vertexOne % m_depthPoints;
+    int di = s.vertexTwo / m_depthPoints - i;
+    int dj = s.vertexTwo % m_depthPoints - j;
+
+    if (di == 1 && dj == 0) return 0 + i % 2;         //structural right
+    if (di == 0 && dj == 1) return 2 + j % 2;         //structural top
+    if (di == 1 && dj == 1) return 4 + i % 2;         //shear top diagonal
+    if (di == 1 && dj == -1) return 6 + i % 2;        //shear bottom diagonal
+    if (di == 2 && dj == 0) return 8 + (i / 2) % 2;   //bend right
+    return 10 + (j / 2) % 2;                          //bend top
+}
+
+
+void Cloth::colorSprings() {
+    m_springColorOffsets.assign(springColorCount + 1, 0);
+    for (const Spring &s : m_springs) {
+        m_springColorOffsets[springColor(s) + 1]++;
+    }
+
+    for (int c = 0; c < springColorCount; c++) {
+        m_springColorOffsets[c + 1] += m_springColorOffsets[c];
+    }
+
+    //stable counting sort, springs keep their creation order within a color
+    std::vector<Spring> sorted(m_springs.size());
+    std::vector<int> cursor(m_springColorOffsets.begin(), m_springColorOffsets.end() - 1);
+    for (const Spring &s : m_springs) {
+        sorted[cursor[springColor(s)]++] = s;
+    }
+    m_springs.swap(sorted);
+}
+
+
+void Cloth::buildAdjacency() {
+    int n = vertexCount();
+
+    //count the springs touching each vertex
+    m_adjacencyOffsets.assign(n + 1, 0);
+    for (const Spring &s : m_springs) {
+        m_adjacencyOffsets[s.vertexOne + 1]++;
+        m_adjacencyOffsets[s.vertexTwo + 1]++;
+    }
+
+    for (int i = 0; i < n; i++) {
+        m_adjacencyOffsets[i + 1] += m_adjacencyOffsets[i];
+    }
+
+    //scatter both endpoints of every spring into their rows
+    m_adjacency.resize(m_adjacencyOffsets[n]);
+    std::vector<int> cursor(m_adjacencyOffsets.begin(), m_adjacencyOffsets.end() - 1);
+    for (const Spring &s : m_springs) {
+        m_adjacency[cursor[s.vertexOne]++] = s.vertexTwo;
+        m_adjacency[cursor[s.vertexTwo]++] = s.vertexOne;
+    }
+
+    for (int i = 0; i < n; i++) {
+        std::sort(m_adjacency.begin() + m_adjacencyOffsets[i], m_adjacency.begin() + m_adjacencyOffsets[i + 1]);
+    }
+}
+
+
+void Cloth::buildTiles() {
+    m_tiles.clear();
+
+    for (int i = 0; i < m_widthPoints; i += tileSize) {
+        for (int j = 0; j < m_depthPoints; j += tileSize) {
+            m_tiles.push_back({i, std::min(i + tileSize, m_widthPoints), j, std::min(j + tileSize, m_depthPoints)});
+        }
+    }
+
+    m_vertexTiles.assign(vertexCount(), 0);
+    for (int t = 0; t < m_tiles.size(); t++) {
+        const ClothTile &tile = m_tiles[t];
+        for (int i = tile.iBegin; i < tile.iEnd; i++) {
+            for (int j = tile.jBegin; j < tile.jEnd; j++) {
+                m_vertexTiles[gridIndex(i, j)] = t;
             }
         }
     }
+    m_sleepingTileCount = 0;
+}
+
+
+//freezes the tile where it is, with zero velocity so it does not jump when it wakes
+void Cloth::sleepTile(int t) {
+    ClothTile &tile = m_tiles[t];
+    if (tile.asleep) {
+        return;
+    }
+
+    tile.asleep = true;
+    m_sleepingTileCount++;
+    tile.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    tile.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+    for (int i = tile.iBegin; i < tile.iEnd; i++) {
+        for (int j = tile.jBegin; j < tile.jEnd; j++) {
+            int v = gridIndex(i, j);
+            m_flags[v] |= VERTEX_SLEEPING;
+            m_prevPositions[v] = m_positions[v];
+            tile.boundsMin = glm::min(tile.boundsMin, m_positions[v]);
+            tile.boundsMax = glm::max(tile.boundsMax, m_positions[v]);
+        }
+    }
+}
+
+
+void Cloth::wakeTile(int t) {
+    ClothTile &tile = m_tiles[t];
+    tile.quietSteps = 0;
+    if (!tile.asleep) {
+        return;
+    }
+
+    tile.asleep = false;
+    m_sleepingTileCount--;
+    for (int i = tile.iBegin; i < tile.iEnd; i++) {
+        for (int j = tile.jBegin; j < tile.jEnd; j++) {
+            m_flags[gridIndex(i, j)] &= ~VERTEX_SLEEPING;
+        }
+    }
+}
+
+
+void Cloth::wakeAll() {
+    for (int t = 0; t < m_tiles.size(); t++) {
+        wakeTile(t);
+    }
 }
 
 
 void Cloth::setTriangleIndices() {
     m_triangleIndices.clear();
 
-    int widthPoints = static_cast<int>(width / widthStep) + 1;
-    int depthPoints = static_cast<int>(depth / depthStep) + 1;
+    int widthPoints = m_widthPoints;
+    int depthPoints = m_depthPoints;
 
     for (int i = 0; i < widthPoints-1; i++) {
         for (int j = 0; j < depthPoints-1; j++) {
@@ -130,42 +295,127 @@ void Cloth::setTriangleIndices() {
 }
 
 
-void Cloth::setNormals() {
-    for (auto &v : m_vertices) {
-        v.normal = glm::vec3(0.f, 0.f, 0.f);
+void Cloth::buildVertexTriangles() {
+    int n = vertexCount();
+    int triangleCount = m_triangleIndices.size() / 3;
+
+    m_vertexTriangleOffsets.assign(n + 1, 0);
+    for (GLuint index : m_triangleIndices) {
+        m_vertexTriangleOffsets[index + 1]++;
+    }
+
+    for (int i = 0; i < n; i++) {
+        m_vertexTriangleOffsets[i + 1] += m_vertexTriangleOffsets[i];
+    }
+
+    //triangles are scattered in index order, so each row is already ascending
+    m_vertexTriangles.resize(m_vertexTriangleOffsets[n]);
+    std::vector<int> cursor(m_vertexTriangleOffsets.begin(), m_vertexTriangleOffsets.end() - 1);
+    for (int t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++) {
+            m_vertexTriangles[cursor[m_triangleIndices[3*t + k]]++] = t;
+        }
+    }
+
+    m_faceNormals.assign(triangleCount, glm::vec3(0.f));
+}
+
+
+void Cloth::buildEdges() {
+    int triangleCount = m_triangleIndices.size() / 3;
+
+    //every triangle side as (smaller vertex, larger vertex, slot in m_triangleEdges)
+    std::vector<glm::ivec3> sides(3 * triangleCount);
+    for (int t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++) {
+            int a = m_triangleIndices[3*t + k];
+            int b = m_triangleIndices[3*t + (k + 1) % 3];
+            sides[3*t + k] = glm::ivec3(std::min(a, b), std::max(a, b), 3*t + k);
+        }
     }
 
-    for (int i = 0; i < m_triangleIndices.size(); i += 3) {
-        int index0 = m_triangleIndices[i];
-        int index1 = m_triangleIndices[i + 1];
-        int index2 = m_triangleIndices[i + 2];
+    std::sort(sides.begin(), sides.end(), [](const glm::ivec3 &l, const glm::ivec3 &r) {
+        return l.x != r.x ? l.x < r.x : l.y != r.y ? l.y < r.y : l.z < r.z;
+    });
 
-        glm::vec3 normal = glm::normalize(glm::cross(m_vertices[index2].pos - m_vertices[index1].pos, m_vertices[index1].pos - m_vertices[index0].pos));
+    //sides shared by two triangles sit next to each other after sorting
+    m_edges.clear();
+    m_triangleEdges.resize(3 * triangleCount);
+    for (int k = 0; k < sides.size(); k++) {
+        if (k == 0 || sides[k].x != sides[k - 1].x || sides[k].y != sides[k - 1].y) {
+            m_edges.push_back(glm::ivec2(sides[k].x, sides[k].y));
+        }
+        m_triangleEdges[sides[k].z] = m_edges.size() - 1;
+    }
+
+    m_edgeVisit.assign(m_edges.size(), -1);
+}
+
+
+void Cloth::faceNormalRange(int begin, int end) {
+    const std::vector<glm::vec3> &pos = m_renderPositions; //normals are only used for drawing
 
-        m_vertices[index0].normal += normal;
-        m_vertices[index1].normal += normal;
-        m_vertices[index2].normal += normal;
+    for (int t = begin; t < end; t++) {
+        int index0 = m_triangleIndices[3*t];
+        int index1 = m_triangleIndices[3*t + 1];
+        int index2 = m_triangleIndices[3*t + 2];
+
+        m_faceNormals[t] = glm::normalize(glm::cross(pos[index2] - pos[index1], pos[index1] - pos[index0]));
     }
+}
+
 
-    for (auto &v : m_vertices) {
-        v.normal = glm::normalize(v.normal);
+//gathers instead of scattering so vertices can be split across threads,
+//faces are summed in triangle order like the old scatter loop
+void Cloth::vertexNormalRange(int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        glm::vec3 n(0.f);
+        for (int e = m_vertexTriangleOffsets[i]; e < m_vertexTriangleOffsets[i + 1]; e++) {
+            n += m_faceNormals[m_vertexTriangles[e]];
+        }
+        m_normals[i] = glm::normalize(n);
     }
 }
 
 
+void Cloth::setNormals() {
+    faceNormalRange(0, m_faceNormals.size());
+    vertexNormalRange(0, vertexCount());
+}
+
+
+void Cloth::setNormals(ThreadPool &pool) {
+    pool.parallelFor(0, m_faceNormals.size(), settings.parallelGrainSize, [&](int begin, int end) {
+        faceNormalRange(begin, end);
+    });
+    pool.parallelFor(0, vertexCount(), settings.parallelGrainSize, [&](int begin, int end) {
+        vertexNormalRange(begin, end);
+    });
+}
+
+
 void Cloth::updateClothPos(glm::vec3 newSphereTop, bool left) {
 
     glm::vec3 offset = glm::abs(sphereTop - newSphereTop);
 
-    for (auto &v : m_vertices) {
-        if (left) {
-            v.pos = v.pos - offset;
-        }
-        else {
-            v.pos = v.pos + offset;
-        }
+    if (left) {
+        offset = -offset;
+    }
+
+    //keep the interpolation endpoints together so the drawn cloth moves with it
+    for (auto &p : m_positions) {
+        p = p + offset;
+    }
+    for (auto &p : m_lastStepPositions) {
+        p = p + offset;
+    }
+    for (auto &p : m_renderPositions) {
+        p = p + offset;
     }
 
     sphereTop = newSphereTop;
+
+    //the cloth was moved from outside the solver
+    wakeAll();
 }
 
@@ -2,18 +2,19 @@
 
 #include <glm/glm.hpp>
 #include <vector>
+#include <cstdlib>
+#include <algorithm>
 #include <GL/glew.h>
+#include "src/spatialhash.h"
+#include "src/trianglebvh.h"
+#include "src/implicitsolver.h"
+#include "src/projectivesolver.h"
 
-struct Vertex {
-    glm::vec3 pos;
-    glm::vec3 prev_pos;
-    float mass;
-    bool anchored;
-    glm::vec3 normal;
-    glm::vec2 uv; //texture
-    glm::vec3 forces; //friction and normal
-    float radius; //marble around each vertex
-    std::vector<GLuint> neighbors; //neighboring vertices
+class ThreadPool;
+
+enum VertexFlag : unsigned char {
+    VERTEX_ANCHORED = 1 << 0,
+    VERTEX_SLEEPING = 1 << 1 //part of a sleeping tile, frozen like an anchored vertex until the tile wakes
 };
 
 enum class SpringType {
@@ -22,6 +23,20 @@ enum class SpringType {
     BEND
 };
 
+//block of the vertex grid, vertices i * depthPoints + j for i in [iBegin, iEnd) and j in [jBegin, jEnd)
+struct ClothTile {
+    int iBegin;
+    int iEnd;
+    int jBegin;
+    int jEnd;
+
+    //island sleeping, a tile that has been still for a while is frozen until something disturbs it
+    int quietSteps = 0; //consecutive steps below the sleep energy
+    bool asleep = false;
+    glm::vec3 boundsMin = glm::vec3(0.f); //box of the frozen vertices, valid while asleep
+    glm::vec3 boundsMax = glm::vec3(0.f);
+};
+
 struct Spring {
     int vertexOne;
     int vertexTwo;
@@ -29,32 +44,127 @@ struct Spring {
     float dampness;
     SpringType type;
     float rest_length;
+    float compliance; //inverse stiffness, xpbd only
+    float lambda; //accumulated lagrange multiplier for the current step, xpbd only
+};
+
+//size, resolution, placement and material of one cloth, so each instance in a scene can differ
+struct ClothDescriptor {
+    float width = 2.f;
+    float depth = 2.f;
+    float widthStep = 0.3f; //grid spacing along x
+    float depthStep = 0.3f; //grid spacing along z
+    glm::vec3 origin = glm::vec3(-1.f, 0.f, -1.f); //bottom left corner, the grid grows towards +x and +z
+    float structuralK = 50;
+    float shearK = 25;
+    float bendK = 5;
+    float damping = .2;
+    float xpbdComplianceScale = 0.001f; //xpbd compliance is this over the spring k
+
+    bool operator==(const ClothDescriptor &other) const = default;
 };
 
 
 class Cloth
 {
 public:
-    float width;
-    float depth;
-    float widthStep;
-    float depthStep;
-    float height;
-    glm::vec3 bottomLeftPos;
+    ClothDescriptor descriptor; //what this cloth was built from, changing it means building a new cloth
     glm::vec3 sphereTop;
-    Cloth(float w, float d, float wStep, float dStep, float h, glm::vec3 bottomLeft);
+    explicit Cloth(const ClothDescriptor &clothDescriptor);
+
+    //particle state, one contiguous array per field so solver loops only touch what they use
+    std::vector<glm::vec3> m_positions;
+    std::vector<glm::vec3> m_prevPositions;
+    std::vector<float> m_invMasses;
+    std::vector<unsigned char> m_flags; //VertexFlag bits
+    std::vector<glm::vec3> m_contactForces; //friction and normal
+
+    //cold per vertex data, only needed for rendering and topology
+    std::vector<glm::vec3> m_lastStepPositions; //positions before the most recent fixed step
+    std::vector<glm::vec3> m_renderPositions; //blend of the last two fixed step states, what gets drawn
+    std::vector<glm::vec3> m_normals; //of m_renderPositions
+    std::vector<glm::vec2> m_uvs; //texture
+
+    //spring adjacency in compressed sparse row form, built once per topology
+    //neighbors of vertex i are m_adjacency[m_adjacencyOffsets[i] .. m_adjacencyOffsets[i+1]), sorted
+    std::vector<int> m_adjacencyOffsets;
+    std::vector<int> m_adjacency;
 
-    std::vector<Vertex> m_vertices;
+    //springs are sorted by color, no two springs of the same color share a vertex
+    //so each color can be projected in parallel; color c is m_springs[m_springColorOffsets[c] .. m_springColorOffsets[c+1])
+    static const int springColorCount = 12;
     std::vector<Spring> m_springs;
+    std::vector<int> m_springColorOffsets;
     std::vector<GLuint> m_triangleIndices;
 
+    //grid blocks of up to tileSize x tileSize vertices, body collisions are culled per tile
+    static const int tileSize = 8;
+    std::vector<ClothTile> m_tiles;
+    std::vector<int> m_vertexTiles; //tile of each vertex
+    int m_sleepingTileCount = 0;
+
+    //unique triangle edges, and the 3 edges of triangle t at m_triangleEdges[3t .. 3t+2]
+    std::vector<glm::ivec2> m_edges;
+    std::vector<int> m_triangleEdges;
+
+    //triangles touching vertex i are m_vertexTriangles[m_vertexTriangleOffsets[i] .. m_vertexTriangleOffsets[i+1]), ascending
+    std::vector<int> m_vertexTriangleOffsets;
+    std::vector<int> m_vertexTriangles;
+
+    //solver scratch, sized once per topology so a simulation step does not allocate
+    std::vector<glm::vec3> m_forces;
+    std::vector<glm::vec3> m_faceNormals;
+    SpatialHash m_selfCollisionHash; //broadphase for cloth to cloth collisions
+    TriangleBVH m_triangleBVH; //broadphase for triangle level self collision
+    ImplicitSolver m_implicitSolver; //system matrix pattern for the implicit euler solver, built on its first step
+    ProjectiveSolver m_projectiveSolver; //prefactored global matrix for projective dynamics, built on its first step
+    std::vector<int> m_edgeVisit; //last edge each edge was tested against, so each edge pair is tested once
+    std::vector<glm::vec3> m_iteratePositions; //positions at the start of the current solver iteration
+    std::vector<glm::vec3> m_previousIteratePositions; //and of the one before, for chebyshev acceleration
+
+    inline int vertexCount() const { return m_positions.size(); }
+    inline int gridIndex(int i, int j) const { return i * m_depthPoints + j; }
+    inline bool isAnchored(int i) const { return m_flags[i] & VERTEX_ANCHORED; }
+    inline void setAnchored(int i) { m_flags[i] |= VERTEX_ANCHORED; }
+    inline bool isSleeping(int i) const { return m_flags[i] & VERTEX_SLEEPING; }
+    inline bool isFixed(int i) const { return m_flags[i] & (VERTEX_ANCHORED | VERTEX_SLEEPING); } //the solver must not move it
+    inline bool allAsleep() const { return m_sleepingTileCount == (int)m_tiles.size(); }
+
+    void sleepTile(int t);
+    void wakeTile(int t);
+    void wakeAll();
+
+    //binary search of the adjacency table, works for any topology
+    inline bool hasNeighbor(int a, int b) const {
+        return std::binary_search(m_adjacency.begin() + m_adjacencyOffsets[a], m_adjacency.begin() + m_adjacencyOffsets[a + 1], b);
+    }
+
+    //constant time check for a spring between a and b, using the grid offsets createSprings connects
+    inline bool areConnected(int a, int b) const {
+        int di = std::abs(a / m_depthPoints - b / m_depthPoints);
+        int dj = std::abs(a % m_depthPoints - b % m_depthPoints);
+        return (di <= 1 && dj <= 1 && di + dj > 0) || (di == 2 && dj == 0) || (di == 0 && dj == 2);
+    }
+
     void setNormals();
+    void setNormals(ThreadPool &pool);
     void updateClothPos(glm::vec3 newSphereTop, bool left);
 
 
 private:
+    int m_widthPoints;
+    int m_depthPoints;
+
     void setTriangleIndices();
+    void buildVertexTriangles();
+    void buildEdges();
+    void faceNormalRange(int begin, int end);
+    void vertexNormalRange(int begin, int end);
     void createVertices();
     void createSprings();
+    int springColor(const Spring &s) const;
+    void colorSprings();
+    void buildAdjacency();
+    void buildTiles();
 };
 
@@ -1,21 +1,27 @@
 #include "src/realtime.h"
 #include "src/settings.h"
 
-void Realtime::clothvbovaoGeneration() {
+//every cloth is packed into the same buffers one after the other, so each render type is a single draw
+//the buffers and vaos only change with the topology, a new set of cloths or another render type,
+//every other frame just streams the moved positions into them
+void Realtime::createClothBuffers() {
+    deleteClothBuffers();
+
+    //first vertex and spring of each cloth in the packed buffers
+    m_clothVertexOffsets.assign(m_cloths.size() + 1, 0);
+    m_clothSpringOffsets.assign(m_cloths.size() + 1, 0);
+    for (int k = 0; k < m_cloths.size(); k++) {
+        m_clothVertexOffsets[k + 1] = m_clothVertexOffsets[k] + m_cloths[k]->vertexCount();
+        m_clothSpringOffsets[k + 1] = m_clothSpringOffsets[k] + m_cloths[k]->m_springs.size();
+    }
+    m_clothDrawVertices = m_clothVertexOffsets.back();
+    m_springDrawVertices = 2 * m_clothSpringOffsets.back();
 
     if (settings.renderType == RenderType::vertices) {
-        //cloth vertices
+        //cloth vertices, position only
         glGenBuffers(1, &m_cloth_vbo);
         glBindBuffer(GL_ARRAY_BUFFER, m_cloth_vbo);
-
-        std::vector<float> verticePositions;
-        for (auto vertex : m_cloth->m_vertices) {
-            verticePositions.push_back(vertex.pos.x);
-            verticePositions.push_back(vertex.pos.y);
-            verticePositions.push_back(vertex.pos.z);
-        }
-
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * verticePositions.size(), verticePositions.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 3 * m_clothDrawVertices, nullptr, GL_STREAM_DRAW);
 
         glGenVertexArrays(1, &m_cloth_vao);
         glBindVertexArray(m_cloth_vao);
@@ -26,96 +32,192 @@ void Realtime::clothvbovaoGeneration() {
         glBindVertexArray(0);
 
 
-        //cloth springs
-        glGenBuffers(1, &m_spring_vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, m_spring_vbo);
-
-        std::vector<float> springData;
-        for (auto spring : m_cloth->m_springs) {
-
-            glm::vec3 color;
-
-            if (spring.type == SpringType::STRUCTURAL) {
-                color = glm::vec3(1, 0, 0); //Red
-            }
-            else if (spring.type == SpringType::SHEAR) {
-                color = glm::vec3(0, 1, 0); //Green
+        //cloth springs, lines between the same streamed positions through a static index buffer
+        std::vector<GLuint> springIndices(m_springDrawVertices);
+        std::vector<GLubyte> springTypes(m_springDrawVertices / 2);
+        for (int k = 0; k < m_cloths.size(); k++) {
+            const Cloth &cloth = *m_cloths[k];
+            for (int i = 0; i < cloth.m_springs.size(); i++) {
+                const Spring &spring = cloth.m_springs[i];
+                int line = m_clothSpringOffsets[k] + i;
+                springIndices[2*line] = spring.vertexOne + m_clothVertexOffsets[k];
+                springIndices[2*line + 1] = spring.vertexTwo + m_clothVertexOffsets[k];
+                springTypes[line] = static_cast<GLubyte>(spring.type);
             }
-            else if (spring.type == SpringType::BEND) {
-                color = glm::vec3(0, 0, 1); //Blue
-            }
-
-            Vertex* vOne = &m_cloth->m_vertices[spring.vertexOne];
-            springData.push_back(vOne->pos.x);
-            springData.push_back(vOne->pos.y);
-            springData.push_back(vOne->pos.z);
-            springData.push_back(color.x);
-            springData.push_back(color.y);
-            springData.push_back(color.z);
-
-            Vertex* vTwo = &m_cloth->m_vertices[spring.vertexTwo];
-            springData.push_back(vTwo->pos.x);
-            springData.push_back(vTwo->pos.y);
-            springData.push_back(vTwo->pos.z);
-            springData.push_back(color.x);
-            springData.push_back(color.y);
-            springData.push_back(color.z);
         }
 
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * springData.size(), springData.data(), GL_STATIC_DRAW);
-
         glGenVertexArrays(1, &m_spring_vao);
         glBindVertexArray(m_spring_vao);
 
+        glBindBuffer(GL_ARRAY_BUFFER, m_cloth_vbo);
         glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6*sizeof(GLfloat), reinterpret_cast<void*>(0));
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(GLfloat), reinterpret_cast<void*>(0));
 
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6*sizeof(GLfloat), reinterpret_cast<void*>(3*sizeof(GLfloat)));
+        glGenBuffers(1, &m_spring_ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_spring_ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * springIndices.size(), springIndices.data(), GL_STATIC_DRAW);
 
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindVertexArray(0);
+
+        //spring type per line, read by the fragment shader with gl_PrimitiveID since a line has no attribute of its own
+        glGenBuffers(1, &m_spring_type_buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, m_spring_type_buffer);
+        glBufferData(GL_TEXTURE_BUFFER, springTypes.size(), springTypes.data(), GL_STATIC_DRAW);
+
+        glGenTextures(1, &m_spring_type_texture);
+        glBindTexture(GL_TEXTURE_BUFFER, m_spring_type_texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, m_spring_type_buffer);
+
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
     }
 
     else { //for rendering cloth with normals or texture
 
+        //interleaved position and normal, rewritten every frame
         glGenBuffers(1, &m_cloth_vbo);
         glBindBuffer(GL_ARRAY_BUFFER, m_cloth_vbo);
-
-        m_cloth->setNormals(); //bc position of vertices changed
-
-        std::vector<float> verticePositions;
-        for (auto vertex : m_cloth->m_vertices) {
-            verticePositions.push_back(vertex.pos.x);
-            verticePositions.push_back(vertex.pos.y);
-            verticePositions.push_back(vertex.pos.z);
-            verticePositions.push_back(vertex.normal.x);
-            verticePositions.push_back(vertex.normal.y);
-            verticePositions.push_back(vertex.normal.z);
-            verticePositions.push_back(vertex.uv.x);
-            verticePositions.push_back(vertex.uv.y);
-        }
-
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * verticePositions.size(), verticePositions.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * m_clothDrawVertices, nullptr, GL_STREAM_DRAW);
 
         glGenVertexArrays(1, &m_cloth_vao);
         glBindVertexArray(m_cloth_vao);
 
         glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8*sizeof(GLfloat), reinterpret_cast<void*>(0));
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6*sizeof(GLfloat), reinterpret_cast<void*>(0));
 
         glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8*sizeof(GLfloat), reinterpret_cast<void*>(3*sizeof(GLfloat)));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6*sizeof(GLfloat), reinterpret_cast<void*>(3*sizeof(GLfloat)));
+
+        //uvs never change, so they live in their own buffer uploaded once
+        std::vector<float> uvs(2 * m_clothDrawVertices);
+        for (int k = 0; k < m_cloths.size(); k++) {
+            const Cloth &cloth = *m_cloths[k];
+            for (int i = 0; i < cloth.vertexCount(); i++) {
+                uvs[2 * (m_clothVertexOffsets[k] + i)] = cloth.m_uvs[i].x;
+                uvs[2 * (m_clothVertexOffsets[k] + i) + 1] = cloth.m_uvs[i].y;
+            }
+        }
+
+        glGenBuffers(1, &m_cloth_uv_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, m_cloth_uv_vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * uvs.size(), uvs.data(), GL_STATIC_DRAW);
 
         glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8*sizeof(GLfloat), reinterpret_cast<void*>(6*sizeof(GLfloat)));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2*sizeof(GLfloat), reinterpret_cast<void*>(0));
+
+        //triangle indices of each cloth, shifted to where its vertices start
+        std::vector<GLuint> triangleIndices;
+        for (int k = 0; k < m_cloths.size(); k++) {
+            for (GLuint index : m_cloths[k]->m_triangleIndices) {
+                triangleIndices.push_back(index + m_clothVertexOffsets[k]);
+            }
+        }
+        m_clothDrawIndices = triangleIndices.size();
 
         glGenBuffers(1, &m_cloth_ebo);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_cloth_ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLint) * m_cloth->m_triangleIndices.size(), m_cloth->m_triangleIndices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLint) * triangleIndices.size(), triangleIndices.data(), GL_STATIC_DRAW);
 
 
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindVertexArray(0);
     }
+
+    m_clothBufferRenderType = settings.renderType;
+    m_clothBuffersDirty = false;
+}
+
+
+//glDelete* ignores the zero names of buffers that were never created
+void Realtime::deleteClothBuffers() {
+    glDeleteBuffers(1, &m_cloth_vbo);
+    glDeleteBuffers(1, &m_cloth_uv_vbo);
+    glDeleteBuffers(1, &m_cloth_ebo);
+    glDeleteVertexArrays(1, &m_cloth_vao);
+
+    glDeleteBuffers(1, &m_spring_ebo);
+    glDeleteBuffers(1, &m_spring_type_buffer);
+    glDeleteTextures(1, &m_spring_type_texture);
+    glDeleteVertexArrays(1, &m_spring_vao);
+
+    m_cloth_vbo = 0;
+    m_cloth_uv_vbo = 0;
+    m_cloth_ebo = 0;
+    m_cloth_vao = 0;
+    m_spring_ebo = 0;
+    m_spring_type_buffer = 0;
+    m_spring_type_texture = 0;
+    m_spring_vao = 0;
+    m_clothDrawVertices = 0;
+    m_clothDrawIndices = 0;
+    m_springDrawVertices = 0;
+}
+
+
+//maps the whole buffer with its old contents invalidated, the driver hands back fresh storage instead of
+//waiting for draws still reading last frame's data, and the pool writes straight into it
+static float *mapForStreaming(GLuint buffer, GLsizeiptr bytes) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    return static_cast<float*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+}
+
+
+//writes this frame's positions, and normals when shaded, into the buffers of the current topology
+void Realtime::clothvbovaoGeneration() {
+    if (m_clothBuffersDirty || m_clothBufferRenderType != settings.renderType) {
+        createClothBuffers();
+    }
+    if (m_clothDrawVertices == 0) {
+        return;
+    }
+
+    if (settings.renderType == RenderType::vertices) {
+        //cloth vertices
+        float *verticePositions = mapForStreaming(m_cloth_vbo, sizeof(GLfloat) * 3 * m_clothDrawVertices);
+        if (verticePositions) {
+            for (int k = 0; k < m_cloths.size(); k++) {
+                const Cloth &cloth = *m_cloths[k];
+                float *clothOut = &verticePositions[3 * m_clothVertexOffsets[k]];
+                m_threadPool.parallelFor(0, cloth.vertexCount(), settings.parallelGrainSize, [&](int begin, int end) {
+                    for (int i = begin; i < end; i++) {
+                        const glm::vec3 &pos = cloth.m_renderPositions[i];
+                        clothOut[3*i] = pos.x;
+                        clothOut[3*i + 1] = pos.y;
+                        clothOut[3*i + 2] = pos.z;
+                    }
+                });
+            }
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+    }
+
+    else { //for rendering cloth with normals or texture
+        for (Cloth *cloth : m_cloths) {
+            cloth->setNormals(m_threadPool); //bc position of vertices changed
+        }
+
+        //interleaved position, normal
+        float *verticePositions = mapForStreaming(m_cloth_vbo, sizeof(GLfloat) * 6 * m_clothDrawVertices);
+        if (verticePositions) {
+            for (int k = 0; k < m_cloths.size(); k++) {
+                const Cloth &cloth = *m_cloths[k];
+                float *clothOut = &verticePositions[6 * m_clothVertexOffsets[k]];
+                m_threadPool.parallelFor(0, cloth.vertexCount(), settings.parallelGrainSize, [&](int begin, int end) {
+                    for (int i = begin; i < end; i++) {
+                        float *out = &clothOut[6*i];
+                        out[0] = cloth.m_renderPositions[i].x;
+                        out[1] = cloth.m_renderPositions[i].y;
+                        out[2] = cloth.m_renderPositions[i].z;
+                        out[3] = cloth.m_normals[i].x;
+                        out[4] = cloth.m_normals[i].y;
+                        out[5] = cloth.m_normals[i].z;
+                    }
+                });
+            }
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
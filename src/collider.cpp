@@ -0,0 +1,47 @@
+#include "collider.h"
+
+
+//conservative advancement: no point on the moving segment moves faster than its faster endpoint,
+//so stepping time by gap / (vertex speed + segment speed) can never step past the first contact
+bool Collider::tunneled(const glm::vec3 &from, const glm::vec3 &to, float surface, glm::vec3 &contact, glm::vec3 &normal) const {
+    const float tolerance = 1e-4f;
+    const int maxIterations = 32;
+
+    glm::vec3 vertexMotion = to - from;
+    float maxSpeed = glm::length(vertexMotion) + glm::max(glm::length(a - prevA), glm::length(b - prevB));
+    if (maxSpeed < 1e-7f) {
+        return false;
+    }
+
+    float t = 0.f;
+    for (int iteration = 0; iteration < maxIterations; iteration++) {
+        glm::vec3 p = from + t * vertexMotion;
+        glm::vec3 segmentA = glm::mix(prevA, a, t);
+        glm::vec3 segmentB = glm::mix(prevB, b, t);
+        float s = segmentParam(p, segmentA, segmentB);
+        glm::vec3 offset = p - (segmentA + s * (segmentB - segmentA));
+        float distance = glm::length(offset);
+        float gap = distance - surface;
+
+        if (gap < tolerance) {
+            if (iteration == 0 || distance < 1e-6f) {
+                return false; //started in contact, the static test owns this vertex
+            }
+
+            //same point of the segment at the end of the step, pushed out along the contact normal
+            normal = offset / distance;
+            glm::vec3 end = a + s * (b - a);
+            if (glm::dot(to - end, normal) >= 0.f) {
+                return false; //grazed it and stayed on the same side
+            }
+            contact = end + normal * surface;
+            return true;
+        }
+
+        t += gap / maxSpeed;
+        if (t > 1.f) {
+            return false;
+        }
+    }
+    return false;
+}
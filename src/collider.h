@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+enum class ColliderKind {
+    sphere,
+    capsule
+};
+
+// A body collider in world space, snapshotted from a joint once per simulation
+// step so the per vertex collision loop never touches Joint or its matrices.
+// Both kinds are the set of points within radius of the segment a-b; a sphere
+// is the degenerate segment a == b.
+struct Collider {
+    ColliderKind kind;
+    bool isHead; //vertices resting on top of the head get anchored
+    glm::vec3 a; //parent joint end, or the sphere center
+    glm::vec3 b; //child joint end, or the sphere center
+    glm::vec3 prevA; //a and b at the previous step, for swept tests
+    glm::vec3 prevB;
+    float radius;
+    glm::vec3 boundsMin; //box around everything the collider can push this step, including where it came from
+    glm::vec3 boundsMax;
+
+    //closest point to p on the segment a-b
+    inline glm::vec3 closestPoint(const glm::vec3 &p) const {
+        return a + segmentParam(p, a, b) * (b - a);
+    }
+
+    //swept test for a vertex moving from -> to while the segment moves prevA-prevB -> a-b
+    //true if the vertex passed through the collider during the step and ended up on the far side,
+    //contact and normal then give where it should be put back, on the side it came from
+    bool tunneled(const glm::vec3 &from, const glm::vec3 &to, float surface, glm::vec3 &contact, glm::vec3 &normal) const;
+
+    //parameter in [0, 1] of the point on segment a-b closest to p
+    static inline float segmentParam(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b) {
+        glm::vec3 ab = b - a;
+        float len2 = glm::dot(ab, ab);
+        if (len2 < 1e-12f) {
+            return 0.f;
+        }
+        return glm::clamp(glm::dot(p - a, ab) / len2, 0.f, 1.f);
+    }
+};
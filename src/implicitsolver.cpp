@@ -0,0 +1,191 @@
+#include "implicitsolver.h"
+#include "cloth.h"
+#include <algorithm>
+#include <cmath>
+
+
+void ImplicitSolver::build(const Cloth &cloth) {
+    int n = cloth.vertexCount();
+
+    //3x3 blocks on the diagonal and at (one, two) and (two, one) for every spring
+    std::vector<Eigen::Triplet<float>> entries;
+    entries.reserve(9 * (n + 2 * cloth.m_springs.size()));
+
+    auto addPattern = [&](int a, int b) {
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++) {
+                entries.emplace_back(3*a + r, 3*b + c, 0.f);
+            }
+        }
+    };
+
+    for (int i = 0; i < n; i++) {
+        addPattern(i, i);
+    }
+    for (const Spring &s : cloth.m_springs) {
+        addPattern(s.vertexOne, s.vertexTwo);
+        addPattern(s.vertexTwo, s.vertexOne);
+    }
+
+    m_system.resize(3*n, 3*n);
+    m_system.setFromTriplets(entries.begin(), entries.end());
+    m_system.makeCompressed();
+
+    //columns of a block are adjacent within a row, so one offset per block row is enough
+    m_diagonalBlocks.resize(3*n);
+    for (int i = 0; i < n; i++) {
+        for (int r = 0; r < 3; r++) {
+            m_diagonalBlocks[3*i + r] = valueOffset(3*i + r, 3*i);
+        }
+    }
+
+    m_springBlocks.resize(6 * cloth.m_springs.size());
+    for (int k = 0; k < cloth.m_springs.size(); k++) {
+        const Spring &s = cloth.m_springs[k];
+        for (int r = 0; r < 3; r++) {
+            m_springBlocks[6*k + r] = valueOffset(3*s.vertexOne + r, 3*s.vertexTwo);
+            m_springBlocks[6*k + 3 + r] = valueOffset(3*s.vertexTwo + r, 3*s.vertexOne);
+        }
+    }
+
+    m_velocity.setZero(3*n);
+    m_rhs.setZero(3*n);
+    m_deltaVelocity.setZero(3*n);
+    m_invDiagonal.setZero(3*n);
+    m_residual.setZero(3*n);
+    m_preconditioned.setZero(3*n);
+    m_direction.setZero(3*n);
+    m_product.setZero(3*n);
+}
+
+
+int ImplicitSolver::valueOffset(int row, int column) const {
+    const int *begin = m_system.innerIndexPtr() + m_system.outerIndexPtr()[row];
+    const int *end = m_system.innerIndexPtr() + m_system.outerIndexPtr()[row + 1];
+    return std::lower_bound(begin, end, column) - m_system.innerIndexPtr();
+}
+
+
+void ImplicitSolver::addBlock(const int *rows, const glm::mat3 &block, float sign) {
+    float *values = m_system.valuePtr();
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            values[rows[r] + c] += sign * block[c][r];
+        }
+    }
+}
+
+
+void ImplicitSolver::step(Cloth &cloth, const std::vector<glm::vec3> &forces, float deltaTime, int maxIterations, float tolerance) {
+    int n = cloth.vertexCount();
+    float h = deltaTime;
+    std::vector<glm::vec3> &pos = cloth.m_positions;
+    std::vector<glm::vec3> &prevPos = cloth.m_prevPositions;
+
+    std::fill(m_system.valuePtr(), m_system.valuePtr() + m_system.nonZeros(), 0.f);
+
+    //velocities are implicit in the verlet state, fixed vertices do not move
+    for (int i = 0; i < n; i++) {
+        glm::vec3 v = cloth.isFixed(i) ? glm::vec3(0.f) : (pos[i] - prevPos[i]) / h;
+        glm::vec3 f = cloth.isFixed(i) ? glm::vec3(0.f) : h * (forces[i] + cloth.m_contactForces[i]);
+        float mass = cloth.isFixed(i) ? 1.f : 1.f / cloth.m_invMasses[i];
+        for (int r = 0; r < 3; r++) {
+            m_velocity[3*i + r] = v[r];
+            m_rhs[3*i + r] = f[r];
+            m_system.valuePtr()[m_diagonalBlocks[3*i + r] + r] = mass;
+        }
+    }
+
+    for (int k = 0; k < cloth.m_springs.size(); k++) {
+        const Spring &s = cloth.m_springs[k];
+        int a = s.vertexOne;
+        int b = s.vertexTwo;
+
+        glm::vec3 d = pos[a] - pos[b];
+        float length = glm::length(d);
+        if (length < 1e-6f) {
+            continue;
+        }
+        glm::vec3 dir = d / length;
+        glm::mat3 outer = glm::outerProduct(dir, dir);
+
+        //-df/dx = k * ((1 - rest/l) * (I - nn^T) + nn^T), the transverse term is dropped under compression
+        //so the block stays positive semidefinite, the damping force only acts along n
+        float ratio = std::max(1.f - s.rest_length / length, 0.f);
+        glm::mat3 stiffness = s.k * (ratio * glm::mat3(1.f) + (1.f - ratio) * outer);
+        glm::mat3 block = (h * h) * stiffness + (h * s.dampness) * outer;
+
+        bool aFree = !cloth.isFixed(a);
+        bool bFree = !cloth.isFixed(b);
+
+        //h * (-h*K*v) on the right hand side, from the positions moving during the step
+        glm::vec3 stiffnessVelocity = (h * h) * (stiffness * (glm::vec3(m_velocity[3*a], m_velocity[3*a + 1], m_velocity[3*a + 2])
+                                                           - glm::vec3(m_velocity[3*b], m_velocity[3*b + 1], m_velocity[3*b + 2])));
+
+        if (aFree) {
+            addBlock(&m_diagonalBlocks[3*a], block, 1.f);
+            for (int r = 0; r < 3; r++) {
+                m_rhs[3*a + r] -= stiffnessVelocity[r];
+            }
+        }
+        if (bFree) {
+            addBlock(&m_diagonalBlocks[3*b], block, 1.f);
+            for (int r = 0; r < 3; r++) {
+                m_rhs[3*b + r] += stiffnessVelocity[r];
+            }
+        }
+        if (aFree && bFree) {
+            addBlock(&m_springBlocks[6*k], block, -1.f);
+            addBlock(&m_springBlocks[6*k + 3], block, -1.f);
+        }
+    }
+
+    m_iterations = solve(maxIterations, tolerance);
+
+    for (int i = 0; i < n; i++) {
+        if (cloth.isFixed(i)) {
+            continue;
+        }
+
+        glm::vec3 v(m_velocity[3*i] + m_deltaVelocity[3*i],
+                    m_velocity[3*i + 1] + m_deltaVelocity[3*i + 1],
+                    m_velocity[3*i + 2] + m_deltaVelocity[3*i + 2]);
+        prevPos[i] = pos[i];
+        pos[i] += h * v;
+    }
+}
+
+
+//preconditioned conjugate gradient on m_system * m_deltaVelocity = m_rhs, warm started from the last solution
+//written out instead of Eigen::ConjugateGradient so the vectors are reused and a step does not allocate
+int ImplicitSolver::solve(int maxIterations, float tolerance) {
+    const float *values = m_system.valuePtr();
+    for (int row = 0; row < m_system.rows(); row++) {
+        float diagonal = values[m_diagonalBlocks[row] + row % 3];
+        m_invDiagonal[row] = diagonal > 0.f ? 1.f / diagonal : 1.f;
+    }
+
+    m_product.noalias() = m_system * m_deltaVelocity;
+    m_residual = m_rhs - m_product;
+    m_preconditioned = m_invDiagonal.cwiseProduct(m_residual);
+    m_direction = m_preconditioned;
+
+    float threshold = tolerance * tolerance * std::max(m_rhs.squaredNorm(), 1e-20f);
+    float rz = m_residual.dot(m_preconditioned);
+
+    int iteration = 0;
+    while (iteration < maxIterations && m_residual.squaredNorm() > threshold) {
+        m_product.noalias() = m_system * m_direction;
+        float alpha = rz / m_direction.dot(m_product);
+        m_deltaVelocity += alpha * m_direction;
+        m_residual -= alpha * m_product;
+
+        m_preconditioned = m_invDiagonal.cwiseProduct(m_residual);
+        float rzNext = m_residual.dot(m_preconditioned);
+        m_direction = m_preconditioned + (rzNext / rz) * m_direction;
+        rz = rzNext;
+        iteration++;
+    }
+
+    return iteration;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <Eigen/Sparse>
+
+class Cloth;
+
+// Backward euler integration of the cloth springs (Baraff and Witkin, Large Steps in Cloth Simulation).
+// Each step solves
+//   (M + h*D + h^2*K) dv = h * (f - h*K*v)
+// for the velocity change dv, where K and D are the stiffness and damping jacobians of the springs,
+// negated so the system is symmetric positive definite. The sparsity pattern only depends on the
+// springs, so it is built once per topology and a step only rewrites the values in place, then runs
+// a diagonally preconditioned conjugate gradient. Anchored and sleeping vertices keep dv = 0.
+class ImplicitSolver
+{
+public:
+    //builds the matrix pattern and sizes every buffer, call again whenever the springs change
+    void build(const Cloth &cloth);
+    inline bool isBuilt() const { return !m_diagonalBlocks.empty(); }
+
+    //moves positions and previous positions forward by deltaTime, forces are the explicit forces at the start of the step
+    void step(Cloth &cloth, const std::vector<glm::vec3> &forces, float deltaTime, int maxIterations, float tolerance);
+
+    inline int lastIterations() const { return m_iterations; }
+
+private:
+    using Matrix = Eigen::SparseMatrix<float, Eigen::RowMajor>;
+
+    int valueOffset(int row, int column) const;
+    void addBlock(const int *rows, const glm::mat3 &block, float sign);
+    int solve(int maxIterations, float tolerance);
+
+    Matrix m_system;
+    //value offsets of the first column of each 3x3 block, one per block row
+    std::vector<int> m_diagonalBlocks; //3 per vertex
+    std::vector<int> m_springBlocks; //6 per spring, rows of block (one, two) then rows of block (two, one)
+
+    //conjugate gradient state, 3 floats per vertex
+    Eigen::VectorXf m_velocity;
+    Eigen::VectorXf m_rhs;
+    Eigen::VectorXf m_deltaVelocity; //also the initial guess, last step's solution
+    Eigen::VectorXf m_invDiagonal;
+    Eigen::VectorXf m_residual;
+    Eigen::VectorXf m_preconditioned;
+    Eigen::VectorXf m_direction;
+    Eigen::VectorXf m_product;
+
+    int m_iterations = 0;
+};
@@ -402,85 +402,92 @@ std::vector<Joint*> Joint::setupSkeleton() {
                 hip, rightHip, rightKnee, rightAnkle, leftHip, leftKnee, leftAnkle, collar, neck, head};
 }
 
-void Joint::drawLine(glm::vec3 a, glm::vec3 b, glm::vec3 color, glm::mat4 VP,
-              GLuint shader, GLuint lineVAO, GLuint lineVBO) {
-    float vertices[6] = {
-        a.x, a.y, a.z,
-        b.x, b.y, b.z
-    };
-
-    glUseProgram(shader);
-
-    glUniform3fv(glGetUniformLocation(shader, "uColor"), 1, &color[0]);
-    glUniformMatrix4fv(glGetUniformLocation(shader, "uVP"), 1, GL_FALSE, &VP[0][0]);
-
-    glBindVertexArray(lineVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, lineVBO);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-
-    glDrawArrays(GL_LINES, 0, 2);
-
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    glUseProgram(0);
+// head features relative to the head circle, in units of its radius
+static const glm::vec3 leftEyeOffset(-0.35f, 0.3f, 0.f);
+static const glm::vec3 rightEyeOffset(0.35f, 0.3f, 0.f);
+static const float eyeScale = 0.1f;
+static const glm::vec3 mouthOffset(0.f, -0.2f, 0.f);
+static const float mouthScale = 0.5f;
+
+// one GL_LINES segment per pair of neighbouring points of a closed unit circle in the x-y plane
+static void addUnitCircle(std::vector<glm::vec2> &out, const std::vector<glm::vec2> &circle) {
+    for (int i = 0; i < circle.size(); i++) {
+        out.push_back(circle[i]);
+        out.push_back(circle[(i + 1) % circle.size()]);
+    }
 }
 
-// draws circle in x-y plane
-void Joint::drawCircle(glm::vec3 c, float r, int param, glm::vec3 color,
-                glm::mat4 VP, GLuint shader, GLuint vao, GLuint vbo)
-{
-    std::vector<float> vertices(3 * param);
-
-    for(int i = 0; i < param; i++) {
-        float theta = i * 2.0f * M_PI / param;
-        vertices[3*i + 0] = c.x + r * cos(theta);
-        vertices[3*i + 1] = c.y + r * sin(theta);
-        vertices[3*i + 2] = c.z;
+// same for an open arc
+static void addUnitArc(std::vector<glm::vec2> &out, const std::vector<glm::vec2> &arc) {
+    for (int i = 0; i + 1 < arc.size(); i++) {
+        out.push_back(arc[i]);
+        out.push_back(arc[i + 1]);
     }
-
-    glUseProgram(shader);
-    glUniform3fv(glGetUniformLocation(shader, "uColor"), 1, &color[0]);
-    glUniformMatrix4fv(glGetUniformLocation(shader, "uVP"), 1, GL_FALSE, &VP[0][0]);
-
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(float), vertices.data());
-
-    glDrawArrays(GL_LINE_LOOP, 0, param);
-
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    glUseProgram(0);
 }
 
-void Joint::drawArc(glm::vec3 c, float r, float a0, float a1,
-             int param, glm::vec3 color, glm::mat4 VP,
-             GLuint shader, GLuint vao, GLuint vbo)
-{
-    std::vector<float> vertices(3 * param);
-
+std::vector<glm::vec2> Joint::skeletonOffsets(const std::vector<Joint*> &joints, int param) {
+    std::vector<glm::vec2> circle(param);
     for (int i = 0; i < param; i++) {
-        float t = float(i) / (param - 1);
-        float theta = a0 + t * (a1 - a0);
+        float theta = i * 2.0f * M_PI / param;
+        circle[i] = glm::vec2(cos(theta), sin(theta));
+    }
 
-        vertices[3*i + 0] = c.x + r * cos(theta);
-        vertices[3*i + 1] = c.y + r * sin(theta);
-        vertices[3*i + 2] = c.z;
+    // lower half, the mouth
+    std::vector<glm::vec2> arc(param);
+    for (int i = 0; i < param; i++) {
+        float theta = M_PI + float(i) / (param - 1) * M_PI;
+        arc[i] = glm::vec2(cos(theta), sin(theta));
     }
 
-    glUseProgram(shader);
-    glUniform3fv(glGetUniformLocation(shader, "uColor"), 1, &color[0]);
-    glUniformMatrix4fv(glGetUniformLocation(shader, "uVP"), 1, GL_FALSE, &VP[0][0]);
+    std::vector<glm::vec2> offsets;
+    offsets.reserve(skeletonVertexCount(joints, param));
+    for (Joint* j : joints) {
+        if (j->getBoneType() == BoneType::CYLINDER) {
+            offsets.push_back(glm::vec2(0.f));
+            offsets.push_back(glm::vec2(0.f));
+        }
+        else if (j->getBoneType() == BoneType::SPHERE) {
+            addUnitCircle(offsets, circle); // head
+            addUnitCircle(offsets, circle); // left eye
+            addUnitCircle(offsets, circle); // right eye
+            addUnitArc(offsets, arc);
+        }
+    }
+    return offsets;
+}
 
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(float), vertices.data());
+int Joint::skeletonVertexCount(const std::vector<Joint*> &joints, int param) {
+    int count = 0;
+    for (Joint* j : joints) {
+        if (j->getBoneType() == BoneType::CYLINDER) {
+            count += 2;
+        }
+        else if (j->getBoneType() == BoneType::SPHERE) {
+            count += 3 * 2 * param + 2 * (param - 1);
+        }
+    }
+    return count;
+}
 
-    glDrawArrays(GL_LINE_STRIP, 0, param);
+void Joint::skeletonAnchors(const std::vector<Joint*> &joints, int param, glm::vec4 *out) {
+    auto fill = [&](glm::vec3 center, float radius, int count) {
+        for (int i = 0; i < count; i++) {
+            *out++ = glm::vec4(center, radius);
+        }
+    };
 
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glUseProgram(0);
+    for (Joint* j : joints) {
+        if (j->getBoneType() == BoneType::CYLINDER) {
+            fill(j->getParent()->getWorldPosition(), 0.f, 1);
+            fill(j->getWorldPosition(), 0.f, 1);
+        }
+        else if (j->getBoneType() == BoneType::SPHERE) {
+            glm::vec3 c = j->getWorldPosition();
+            float r = glm::length(j->getBoneVec());
+            fill(c, r, 2 * param);
+            fill(c + r * leftEyeOffset, eyeScale * r, 2 * param);
+            fill(c + r * rightEyeOffset, eyeScale * r, 2 * param);
+            fill(c + r * mouthOffset, mouthScale * r, 2 * (param - 1));
+        }
+    }
 }
@@ -68,13 +68,13 @@ public:
     static void solveIK(Joint* endJoint, glm::vec3 ikTarget);
 
     static std::vector<Joint*> setupSkeleton();
-    static void drawLine(glm::vec3 a, glm::vec3 b, glm::vec3 color, glm::mat4 VP,
-                         GLuint shader, GLuint lineVAO, GLuint lineVBO);
-    static void drawCircle(glm::vec3 c, float r, int param, glm::vec3 color,
-                           glm::mat4 VP, GLuint shader, GLuint vao, GLuint vbo);
-    static void drawArc(glm::vec3 c, float r, float a0, float a1,
-                        int param, glm::vec3 color, glm::mat4 VP,
-                        GLuint shader, GLuint vao, GLuint vbo);
+    // Skeleton geometry for a single GL_LINES draw. Each vertex is an anchor (center and radius) plus a
+    // unit circle offset, and the shader places it at center + radius * offset. Bone endpoints have radius 0,
+    // and the head's circles and mouth share a unit circle computed once instead of cos/sin every frame.
+    // Offsets only depend on the joints' bone types, so they are built once; anchors are rewritten per frame.
+    static std::vector<glm::vec2> skeletonOffsets(const std::vector<Joint*> &joints, int param);
+    static int skeletonVertexCount(const std::vector<Joint*> &joints, int param);
+    static void skeletonAnchors(const std::vector<Joint*> &joints, int param, glm::vec4 *out);
 
 private:
     std::string m_name;
@@ -62,6 +62,9 @@ void MainWindow::initialize() {
     QLabel *body_label = new QLabel();
     body_label->setText("Body length:");
 
+    QLabel *solverReport = new QLabel(); // solver iterations, filled in by realtime while reporting
+    realtime->setSolverReportLabel(solverReport);
+
     generateCloth = new QCheckBox();
     generateCloth->setText(QStringLiteral("generate cloth"));
     generateCloth->setChecked(false);
@@ -572,6 +575,7 @@ void MainWindow::initialize() {
     vLayout->addWidget(bodyLayout);
 
     vLayout->addWidget(cloth_label);
+    vLayout->addWidget(solverReport);
     vLayout->addWidget(generateCloth);
     vLayout->addWidget(renderNormals);
     vLayout->addWidget(renderVertices);
@@ -0,0 +1,184 @@
+#include "projectivesolver.h"
+#include "cloth.h"
+#include "threadpool.h"
+#include <algorithm>
+
+
+void ProjectiveSolver::build(const Cloth &cloth, float deltaTime, float stiffnessScale) {
+    int n = cloth.vertexCount();
+
+    //diagonal plus both off diagonal entries of every spring, the x, y and z systems are identical
+    std::vector<Eigen::Triplet<double>> entries;
+    entries.reserve(n + 2 * cloth.m_springs.size());
+    for (int i = 0; i < n; i++) {
+        entries.emplace_back(i, i, 0.0);
+    }
+    for (const Spring &s : cloth.m_springs) {
+        entries.emplace_back(s.vertexOne, s.vertexTwo, 0.0);
+        entries.emplace_back(s.vertexTwo, s.vertexOne, 0.0);
+    }
+
+    m_system.resize(n, n);
+    m_system.setFromTriplets(entries.begin(), entries.end());
+    m_system.makeCompressed();
+
+    auto valueOffset = [&](int row, int column) {
+        const int *begin = m_system.innerIndexPtr() + m_system.outerIndexPtr()[column];
+        const int *end = m_system.innerIndexPtr() + m_system.outerIndexPtr()[column + 1];
+        return int(std::lower_bound(begin, end, row) - m_system.innerIndexPtr());
+    };
+
+    m_diagonalEntries.resize(n);
+    for (int i = 0; i < n; i++) {
+        m_diagonalEntries[i] = valueOffset(i, i);
+    }
+    m_springEntries.resize(2 * cloth.m_springs.size());
+    for (int k = 0; k < cloth.m_springs.size(); k++) {
+        const Spring &s = cloth.m_springs[k];
+        m_springEntries[2*k] = valueOffset(s.vertexOne, s.vertexTwo);
+        m_springEntries[2*k + 1] = valueOffset(s.vertexTwo, s.vertexOne);
+    }
+
+    m_anchored.resize(n);
+    m_inertia.resize(n);
+    m_weights.resize(cloth.m_springs.size());
+    m_prediction.setZero(n, 3);
+    m_rhs.setZero(n, 3);
+    m_permuted.setZero(n, 3);
+    m_solution.setZero(n, 3);
+
+    m_ldlt.analyzePattern(m_system);
+    factorize(cloth, deltaTime, stiffnessScale);
+}
+
+
+void ProjectiveSolver::factorize(const Cloth &cloth, float deltaTime, float stiffnessScale) {
+    double invDt2 = 1.0 / (double(deltaTime) * deltaTime);
+    double *values = m_system.valuePtr();
+    std::fill(values, values + m_system.nonZeros(), 0.0);
+
+    for (int i = 0; i < cloth.vertexCount(); i++) {
+        m_anchored[i] = cloth.isAnchored(i);
+        m_inertia[i] = invDt2 / cloth.m_invMasses[i];
+        values[m_diagonalEntries[i]] += m_inertia[i];
+    }
+
+    //each spring adds w * [1 -1; -1 1] over its two vertices, an anchored row keeps only its inertia
+    //and the coupling to it moves to the right hand side, sleeping vertices count as free here
+    for (int k = 0; k < cloth.m_springs.size(); k++) {
+        const Spring &s = cloth.m_springs[k];
+        bool oneAnchored = m_anchored[s.vertexOne];
+        bool twoAnchored = m_anchored[s.vertexTwo];
+        m_weights[k] = double(s.k) * stiffnessScale;
+        if (!oneAnchored) {
+            values[m_diagonalEntries[s.vertexOne]] += m_weights[k];
+        }
+        if (!twoAnchored) {
+            values[m_diagonalEntries[s.vertexTwo]] += m_weights[k];
+        }
+        if (!oneAnchored && !twoAnchored) {
+            values[m_springEntries[2*k]] -= m_weights[k];
+            values[m_springEntries[2*k + 1]] -= m_weights[k];
+        }
+    }
+
+    m_ldlt.factorize(m_system);
+    m_inverseD = m_ldlt.vectorD().cwiseInverse(); //vectorD() returns a copy, so it is taken once here
+    m_factoredStep = deltaTime;
+    m_factoredScale = stiffnessScale;
+}
+
+
+void ProjectiveSolver::update(const Cloth &cloth, float deltaTime, float stiffnessScale) {
+    if (!isBuilt()) {
+        build(cloth, deltaTime, stiffnessScale);
+        return;
+    }
+
+    bool changed = deltaTime != m_factoredStep || stiffnessScale != m_factoredScale;
+    for (int i = 0; i < cloth.vertexCount() && !changed; i++) {
+        changed = cloth.isAnchored(i) != bool(m_anchored[i]);
+    }
+    if (changed) {
+        factorize(cloth, deltaTime, stiffnessScale);
+    }
+}
+
+
+void ProjectiveSolver::predict(Cloth &cloth, const std::vector<glm::vec3> &forces, float deltaTime) {
+    std::vector<glm::vec3> &pos = cloth.m_positions;
+    std::vector<glm::vec3> &prevPos = cloth.m_prevPositions;
+
+    //y = x + h*v + h^2 * f/m, the verlet update without the springs
+    for (int i = 0; i < cloth.vertexCount(); i++) {
+        if (!cloth.isFixed(i)) {
+            glm::vec3 a = (forces[i] + cloth.m_contactForces[i]) * cloth.m_invMasses[i];
+            glm::vec3 y = 2.0f * pos[i] - prevPos[i] + a * deltaTime * deltaTime;
+
+            prevPos[i] = pos[i];
+            pos[i] = y;
+        }
+
+        m_prediction(i, 0) = pos[i].x;
+        m_prediction(i, 1) = pos[i].y;
+        m_prediction(i, 2) = pos[i].z;
+    }
+}
+
+
+void ProjectiveSolver::iterate(Cloth &cloth, ThreadPool &pool, int grainSize) {
+    std::vector<glm::vec3> &pos = cloth.m_positions;
+    int n = cloth.vertexCount();
+
+    //fixed vertices were not predicted, so their inertia holds them where they are
+    pool.parallelFor(0, n, grainSize, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            m_rhs.row(i) = m_inertia[i] * m_prediction.row(i);
+        }
+    });
+
+    //local step, springs of one color share no vertex so each color scatters into the rhs in parallel
+    for (int c = 0; c < Cloth::springColorCount; c++) {
+        pool.parallelFor(cloth.m_springColorOffsets[c], cloth.m_springColorOffsets[c + 1], grainSize, [&](int begin, int end) {
+            for (int k = begin; k < end; k++) {
+                const Spring &s = cloth.m_springs[k];
+
+                glm::vec3 d = pos[s.vertexOne] - pos[s.vertexTwo];
+                float distance = glm::length(d);
+                glm::dvec3 projected(0.0);
+                if (distance >= 1e-6f) {
+                    projected = (m_weights[k] * s.rest_length / distance) * glm::dvec3(d);
+                }
+
+                //an eliminated anchor is a known position, its side of the spring goes to the free vertex's rhs
+                bool oneAnchored = m_anchored[s.vertexOne];
+                bool twoAnchored = m_anchored[s.vertexTwo];
+                for (int axis = 0; axis < 3; axis++) {
+                    if (!oneAnchored) {
+                        m_rhs(s.vertexOne, axis) += projected[axis] + (twoAnchored ? m_weights[k] * m_prediction(s.vertexTwo, axis) : 0.0);
+                    }
+                    if (!twoAnchored) {
+                        m_rhs(s.vertexTwo, axis) += -projected[axis] + (oneAnchored ? m_weights[k] * m_prediction(s.vertexOne, axis) : 0.0);
+                    }
+                }
+            }
+        });
+    }
+
+    //global step, the back substitution of m_ldlt.solve() written out into member storage,
+    //solve() allocates the permuted right hand side and a permutation mask on every call
+    m_permuted.noalias() = m_ldlt.permutationP() * m_rhs;
+    m_ldlt.matrixL().solveInPlace(m_permuted);
+    m_permuted.array().colwise() *= m_inverseD.array();
+    m_ldlt.matrixU().solveInPlace(m_permuted);
+    m_solution.noalias() = m_ldlt.permutationPinv() * m_permuted;
+
+    //sleeping vertices and ones anchored by a collision pass during this step (eliminated by the next update) stay put
+    pool.parallelFor(0, n, grainSize, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            if (!cloth.isFixed(i)) {
+                pos[i] = glm::vec3(m_solution(i, 0), m_solution(i, 1), m_solution(i, 2));
+            }
+        }
+    });
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <Eigen/Sparse>
+
+class Cloth;
+class ThreadPool;
+
+// Projective dynamics (Bouaziz et al., Projective Dynamics: Fusing Constraint Projections for Fast Simulation).
+// A step minimizes  m/(2h^2) |x - y|^2 + sum w/2 |x1 - x2 - p|^2  over the positions x, where y is the
+// inertial prediction and p is the spring vector projected back to its rest length. The local step
+// recomputes every p, the global step solves
+//   (M/h^2 + sum w L) x = M/h^2 y + sum w S^T p
+// for all three coordinates at once. That matrix only depends on the springs, the masses, the
+// timestep, the stiffness scale and which vertices are anchored, so it is factored with a sparse LDLT
+// and every iteration is a back substitution. Anchored vertices are eliminated: their rows keep only
+// the inertia term, so the solve returns them where they are, and their springs move to the right
+// hand side of the free neighbours. Anchors only change on contact with the head, so refactoring
+// whenever the timestep, the stiffness scale or the anchor set changes is rare. Sleeping vertices stay
+// in the system and are simply not moved by the solve, their neighbours see them through the springs'
+// projections.
+class ProjectiveSolver
+{
+public:
+    //assembles and factors the global matrix, call again whenever the springs change
+    void build(const Cloth &cloth, float deltaTime, float stiffnessScale);
+
+    inline bool isBuilt() const { return !m_diagonalEntries.empty(); }
+
+    //builds on first use and refactors if the timestep, the stiffness or the anchored vertices changed,
+    //the only part of the solver that allocates, so it is called before a step rather than inside it
+    void update(const Cloth &cloth, float deltaTime, float stiffnessScale);
+
+    //moves the cloth to its inertial prediction
+    void predict(Cloth &cloth, const std::vector<glm::vec3> &forces, float deltaTime);
+
+    //one parallel local step over the spring colors followed by one global solve
+    void iterate(Cloth &cloth, ThreadPool &pool, int grainSize);
+
+private:
+    //double precision, with stiff springs the spring terms on both sides are orders of magnitude
+    //larger than the inertia term and cancel, float solves drift the whole cloth within seconds
+    using Matrix = Eigen::SparseMatrix<double>;
+    using Points = Eigen::Matrix<double, Eigen::Dynamic, 3>; //one row per vertex
+
+    void factorize(const Cloth &cloth, float deltaTime, float stiffnessScale);
+
+    Matrix m_system;
+    Eigen::SimplicialLDLT<Matrix> m_ldlt;
+    Eigen::VectorXd m_inverseD; //1 / D of the factorization
+    std::vector<int> m_diagonalEntries; //value offset of the diagonal entry of each column
+    std::vector<int> m_springEntries; //2 per spring, offsets of (one, two) and (two, one)
+    float m_factoredStep = 0.f;
+    float m_factoredScale = 0.f;
+    std::vector<unsigned char> m_anchored; //per vertex, whether the factorization eliminates it
+
+    std::vector<double> m_inertia; //m/h^2 per vertex, for the factored timestep
+    std::vector<double> m_weights; //w per spring, k times the stiffness scale
+    Points m_prediction; //y
+    Points m_rhs;
+    Points m_permuted; //P * rhs, solved in place
+    Points m_solution;
+};
@@ -3,6 +3,7 @@
 #include <QCoreApplication>
 #include <QMouseEvent>
 #include <QKeyEvent>
+#include <QLabel>
 #include <iostream>
 #include "settings.h"
 #include "utils/shaderloader.h"
@@ -35,23 +36,19 @@ void Realtime::finish() {
     this->makeCurrent();
 
     // Students: anything requiring OpenGL calls when the program exits should be done here
-    glDeleteProgram(m_figure_shader);
-    glDeleteProgram(m_cloth_normals_shader);
-    glDeleteProgram(m_cloth_vertices_shader);
-    glDeleteProgram(m_cloth_texture_shader);
+    glDeleteProgram(m_figure_shader.id);
+    glDeleteProgram(m_cloth_normals_shader.id);
+    glDeleteProgram(m_cloth_vertices_shader.id);
+    glDeleteProgram(m_cloth_texture_shader.id);
+    glDeleteBuffers(1, &m_camera_ubo);
+    MeshCache::clear();
 
-    glDeleteVertexArrays(1, &m_lineVAO);
-    glDeleteVertexArrays(1, &m_circleVAO);
+    glDeleteVertexArrays(1, &m_skeletonVAO);
 
-    glDeleteBuffers(1, &m_lineVBO);
-    glDeleteBuffers(1, &m_circleVBO);
+    glDeleteBuffers(1, &m_skeletonVBO);
+    glDeleteBuffers(1, &m_skeletonOffsetVBO);
 
-    glDeleteBuffers(1, &m_cloth_vbo);
-    glDeleteVertexArrays(1, &m_cloth_vao);
-    glDeleteBuffers(1, &m_cloth_ebo);
-
-    glDeleteBuffers(1, &m_spring_vbo);
-    glDeleteVertexArrays(1, &m_spring_vao);
+    deleteClothBuffers();
 
     delete m_camera;
 
@@ -59,11 +56,62 @@ void Realtime::finish() {
         delete j;
     }
 
-    if (m_cloth) delete m_cloth;
+    deleteCloths();
 
     this->doneCurrent();
 }
 
+//one cloth per layer, each a full grid of its own, layers are stacked upwards from the bottom left corner
+std::vector<ClothDescriptor> Realtime::clothDescriptors() const {
+    std::vector<ClothDescriptor> descriptors(std::max(settings.clothCount, 1));
+    for (int k = 0; k < descriptors.size(); k++) {
+        ClothDescriptor &descriptor = descriptors[k];
+        descriptor.width = settings.cloth_width;
+        descriptor.depth = settings.cloth_length;
+        descriptor.widthStep = settings.cloth_width_step;
+        descriptor.depthStep = settings.cloth_length_step;
+        descriptor.origin = glm::vec3(settings.x_clothBottomLeft, settings.y_clothBottomLeft + k * settings.clothLayerSpacing, settings.z_clothBottomLeft);
+        descriptor.structuralK = settings.structuralK;
+        descriptor.shearK = settings.shearK;
+        descriptor.bendK = settings.bendK;
+        descriptor.damping = settings.damping;
+        descriptor.xpbdComplianceScale = settings.xpbdComplianceScale;
+    }
+    return descriptors;
+}
+
+
+void Realtime::createCloths() {
+    for (const ClothDescriptor &descriptor : clothDescriptors()) {
+        m_cloths.push_back(new Cloth(descriptor));
+    }
+    m_clothBuffersDirty = true;
+}
+
+
+//whether the cloths were built from what the settings ask for now
+bool Realtime::clothsMatchSettings() const {
+    std::vector<ClothDescriptor> descriptors = clothDescriptors();
+    if (descriptors.size() != m_cloths.size()) {
+        return false;
+    }
+    for (int k = 0; k < descriptors.size(); k++) {
+        if (!(m_cloths[k]->descriptor == descriptors[k])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void Realtime::deleteCloths() {
+    for (Cloth *cloth : m_cloths) {
+        delete cloth;
+    }
+    m_cloths.clear();
+}
+
+
 void Realtime::initializeGL() {
     m_devicePixelRatio = this->devicePixelRatio();
 
@@ -87,14 +135,30 @@ void Realtime::initializeGL() {
     glViewport(0, 0, size().width() * m_devicePixelRatio, size().height() * m_devicePixelRatio);
 
     // Students: anything requiring OpenGL calls when the program starts should be done here
-    m_figure_shader = ShaderLoader::createShaderProgram(":/resources/shaders/default.vert", ":/resources/shaders/default.frag");
-    m_cloth_normals_shader = ShaderLoader::createShaderProgram(":/resources/shaders/cloth_normals.vert", ":/resources/shaders/cloth_normals.frag");
-    m_cloth_vertices_shader = ShaderLoader::createShaderProgram(":/resources/shaders/cloth_vertices.vert", ":/resources/shaders/cloth_vertices.frag");
-    m_cloth_texture_shader = ShaderLoader::createShaderProgram(":/resources/shaders/cloth_texture.vert", ":/resources/shaders/cloth_texture.frag");
+    m_figure_shader = ShaderLoader::createProgram(":/resources/shaders/default.vert", ":/resources/shaders/default.frag");
+    m_cloth_normals_shader = ShaderLoader::createProgram(":/resources/shaders/cloth_normals.vert", ":/resources/shaders/cloth_normals.frag");
+    m_cloth_vertices_shader = ShaderLoader::createProgram(":/resources/shaders/cloth_vertices.vert", ":/resources/shaders/cloth_vertices.frag");
+    m_cloth_texture_shader = ShaderLoader::createProgram(":/resources/shaders/cloth_texture.vert", ":/resources/shaders/cloth_texture.frag");
+
+    //uniform locations are resolved once here, the samplers never change unit so they are set once as well
+    m_figureColorLocation = m_figure_shader.location("uColor");
+    m_colorBySpringTypeLocation = m_cloth_vertices_shader.location("colorBySpringType");
+    glUseProgram(m_cloth_vertices_shader.id);
+    glUniform1i(m_cloth_vertices_shader.location("springTypes"), 0);
+    glUseProgram(m_cloth_texture_shader.id);
+    glUniform1i(m_cloth_texture_shader.location("my_texture"), 0);
+    glUseProgram(0);
+
+    //view, projection and view projection matrices, std140 lays the three mat4s out back to back
+    glGenBuffers(1, &m_camera_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_camera_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, 3 * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, ShaderLoader::cameraBlockBinding, m_camera_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
     //create cloth
     if (settings.generateCloth) {
-        m_cloth = new Cloth(settings.cloth_width, settings.cloth_length, settings.cloth_width_step, settings.cloth_length_step, 0.0f, glm::vec3(settings.x_clothBottomLeft, settings.y_clothBottomLeft, settings.z_clothBottomLeft));
+        createCloths();
     }
 
     // cloth texture
@@ -113,44 +177,33 @@ void Realtime::initializeGL() {
     float aspect = (float)size().width() / size().height();
     m_VP = glm::ortho(-3.f*aspect, 3.f*aspect, -3.f, 3.f, -10.f, 10.f);
 
-    glGenVertexArrays(1, &m_lineVAO);
-    glGenBuffers(1, &m_lineVBO);
-
-    glBindVertexArray(m_lineVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_lineVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6, nullptr, GL_DYNAMIC_DRAW);
+    glLineWidth(10.0f);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    m_joints = Joint::setupSkeleton();
+    m_colliders.reserve(m_joints.size()); //so buildColliders never allocates during a step
 
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    //whole skeleton as one line list, static unit circle offsets and anchors rewritten every frame
+    std::vector<glm::vec2> skeletonOffsets = Joint::skeletonOffsets(m_joints, PARAM);
+    m_skeletonAnchors.resize(skeletonOffsets.size());
 
-    glGenVertexArrays(1, &m_circleVAO);
-    glGenBuffers(1, &m_circleVBO);
+    glGenVertexArrays(1, &m_skeletonVAO);
+    glBindVertexArray(m_skeletonVAO);
 
-    glBindVertexArray(m_circleVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_circleVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * (3 * PARAM), nullptr, GL_DYNAMIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glGenBuffers(1, &m_skeletonVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_skeletonVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * m_skeletonAnchors.size(), nullptr, GL_DYNAMIC_DRAW);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
     glEnableVertexAttribArray(0);
 
-    glGenVertexArrays(1, &m_arcVAO);
-    glGenBuffers(1, &m_arcVBO);
-
-    glBindVertexArray(m_arcVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_arcVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * (3 * PARAM), nullptr, GL_DYNAMIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    glGenBuffers(1, &m_skeletonOffsetVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_skeletonOffsetVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec2) * skeletonOffsets.size(), skeletonOffsets.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+    glEnableVertexAttribArray(1);
 
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    glLineWidth(10.0f);
-
-    m_joints = Joint::setupSkeleton();
-
     m_camera = new Camera();
 
     SceneCameraData data = {
@@ -191,74 +244,58 @@ void Realtime::paintGL() {
     glm::vec3 color = glm::vec3(1.f, 1.f, 1.f);
     m_VP = m_camera->getProjMatrix() * m_camera->getViewMatrix();
 
-    for (Joint* j : m_joints) {
-        if (j->getBoneType() == BoneType::CYLINDER) {
-            Joint::drawLine(j->getParent()->getWorldPosition(), j->getWorldPosition(),
-                     color, m_VP, m_figure_shader, m_lineVAO, m_lineVBO);
-        }
-        else if (j->getBoneType() == BoneType::SPHERE) {
-            glm::vec3 c = j->getWorldPosition();
-            float r = glm::length(j->getBoneVec());
-            Joint::drawCircle(c, r, PARAM,
-                       color, m_VP, m_figure_shader, m_circleVAO, m_circleVBO);
-
-            glm::vec3 leftEye = c + glm::vec3(-0.35f * r, 0.3f * r, 0.f);
-            glm::vec3 rightEye = c + glm::vec3( 0.35f * r, 0.3f * r, 0.f);
-            float eyeRadius = 0.1f * r;
-            Joint::drawCircle(leftEye, eyeRadius, PARAM, color, m_VP, m_figure_shader, m_circleVAO, m_circleVBO);
-            Joint::drawCircle(rightEye, eyeRadius, PARAM, color, m_VP, m_figure_shader, m_circleVAO, m_circleVBO);
-
-            glm::vec3 mouthCenter = c + glm::vec3(0.0f, -0.2f * r, 0.0f);
-            float mouthRadius = 0.5f * r;
-            Joint::drawArc(mouthCenter, mouthRadius, M_PI, 2*M_PI, PARAM, color, m_VP, m_figure_shader, m_arcVAO, m_arcVBO);
-        }
-    }
+    glm::mat4 cameraBlock[3] = {m_camera->getViewMatrix(), m_camera->getProjMatrix(), m_VP};
+    glBindBuffer(GL_UNIFORM_BUFFER, m_camera_ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(cameraBlock), cameraBlock);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    Joint::skeletonAnchors(m_joints, PARAM, m_skeletonAnchors.data());
+
+    glUseProgram(m_figure_shader.id);
+    glUniform3fv(m_figureColorLocation, 1, &color[0]);
+
+    glBindVertexArray(m_skeletonVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_skeletonVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::vec4) * m_skeletonAnchors.size(), m_skeletonAnchors.data());
+
+    glDrawArrays(GL_LINES, 0, m_skeletonAnchors.size());
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     if (settings.generateCloth) {
         if (settings.renderType == RenderType::vertices) {
-            glUseProgram(m_cloth_vertices_shader);
-
-            glUniformMatrix4fv(glGetUniformLocation(m_cloth_vertices_shader, "viewMatrix"), 1, GL_FALSE, &m_camera->getViewMatrix()[0][0]);
-            glUniformMatrix4fv(glGetUniformLocation(m_cloth_vertices_shader, "projMatrix"), 1, GL_FALSE, &m_camera->getProjMatrix()[0][0]);
+            glUseProgram(m_cloth_vertices_shader.id);
 
             //painting vertices in cloth as points
             glPointSize(10.0f);
             glBindVertexArray(m_cloth_vao);
 
-            glm::mat4 identityMatrix = glm::mat4(glm::vec4(1.f, 0.f, 0.f, 0.f), glm::vec4(0.f, 1.f, 0.f, 0.f), glm::vec4(0.f, 0.f, 1.f, 0.f), glm::vec4(0.f, 0.f, 0.f, 1.f));
-            glUniformMatrix4fv(glGetUniformLocation(m_cloth_vertices_shader, "modelMatrix"), 1, GL_FALSE, &identityMatrix[0][0]);
-            glm::mat4 inverseCTM = glm::inverse(identityMatrix); //same thing
-            glUniformMatrix4fv(glGetUniformLocation(m_cloth_vertices_shader, "inverseModelMatrix"), 1, GL_FALSE, &inverseCTM[0][0]);
-
-            glDrawArrays(GL_POINTS, 0, m_cloth->m_vertices.size());
+            glUniform1i(m_colorBySpringTypeLocation, false);
+            glDrawArrays(GL_POINTS, 0, m_clothDrawVertices);
             glBindVertexArray(0);
 
-            //painting springs in cloth as lines
+            //painting springs in cloth as lines, indexed over the same positions, colored by spring type
             glLineWidth(2.0f);
             glBindVertexArray(m_spring_vao);
 
-            glUniformMatrix4fv(glGetUniformLocation(m_cloth_vertices_shader, "modelMatrix"), 1, GL_FALSE, &identityMatrix[0][0]);
-            glUniformMatrix4fv(glGetUniformLocation(m_cloth_vertices_shader, "inverseModelMatrix"), 1, GL_FALSE, &inverseCTM[0][0]);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_BUFFER, m_spring_type_texture);
+            glUniform1i(m_colorBySpringTypeLocation, true);
+
+            glDrawElements(GL_LINES, m_springDrawVertices, GL_UNSIGNED_INT, 0);
 
-            glDrawArrays(GL_LINES, 0, m_cloth->m_springs.size() * 2);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
             glBindVertexArray(0);
         }
 
         else if (settings.renderType == RenderType::normals) {
 
-            glUseProgram(m_cloth_normals_shader);
-
-            glUniformMatrix4fv(glGetUniformLocation(m_cloth_normals_shader, "viewMatrix"), 1, GL_FALSE, &m_camera->getViewMatrix()[0][0]);
-            glUniformMatrix4fv(glGetUniformLocation(m_cloth_normals_shader, "projMatrix"), 1, GL_FALSE, &m_camera->getProjMatrix()[0][0]);
+            glUseProgram(m_cloth_normals_shader.id);
 
             glBindVertexArray(m_cloth_vao);
 
-            glm::mat4 identityMatrix = glm::mat4(glm::vec4(1.f, 0.f, 0.f, 0.f), glm::vec4(0.f, 1.f, 0.f, 0.f), glm::vec4(0.f, 0.f, 1.f, 0.f), glm::vec4(0.f, 0.f, 0.f, 1.f));
-            glUniformMatrix4fv(glGetUniformLocation(m_cloth_normals_shader, "modelMatrix"), 1, GL_FALSE, &identityMatrix[0][0]);
-            glm::mat4 inverseCTM = glm::inverse(identityMatrix); //same thing
-            glUniformMatrix4fv(glGetUniformLocation(m_cloth_normals_shader, "inverseModelMatrix"), 1, GL_FALSE, &inverseCTM[0][0]);
-
-            glDrawElements(GL_TRIANGLES, m_cloth->m_triangleIndices.size(), GL_UNSIGNED_INT, 0);
+            glDrawElements(GL_TRIANGLES, m_clothDrawIndices, GL_UNSIGNED_INT, 0);
 
             glBindVertexArray(0);
 
@@ -267,30 +304,20 @@ void Realtime::paintGL() {
         else if (settings.renderType == RenderType::texture) {
 
             //texture
-            glUseProgram(m_cloth_texture_shader);
+            glUseProgram(m_cloth_texture_shader.id);
 
 
             glActiveTexture(GL_TEXTURE0);
             glBindTexture(GL_TEXTURE_2D, m_cloth_texture);
 
 
-            glUniformMatrix4fv(glGetUniformLocation(m_cloth_texture_shader, "viewMatrix"), 1, GL_FALSE, &m_camera->getViewMatrix()[0][0]);
-            glUniformMatrix4fv(glGetUniformLocation(m_cloth_texture_shader, "projMatrix"), 1, GL_FALSE, &m_camera->getProjMatrix()[0][0]);
-            glUniform1i(glGetUniformLocation(m_cloth_texture_shader, "my_texture"), 0);
-
-            glUniform3fv(glGetUniformLocation(m_cloth_texture_shader, "bottomLeft"), 1, &m_cloth->bottomLeftPos[0]);
-            glUniform1f(glGetUniformLocation(m_cloth_texture_shader, "clothWidth"), m_cloth->width);
-            glUniform1f(glGetUniformLocation(m_cloth_texture_shader, "clothDepth"), m_cloth->depth);
+            //uvs come from the vertices, every cloth in the batch samples the same texture
 
 
             glBindVertexArray(m_cloth_vao);
 
-            glm::mat4 identityMatrix = glm::mat4(glm::vec4(1.f, 0.f, 0.f, 0.f), glm::vec4(0.f, 1.f, 0.f, 0.f), glm::vec4(0.f, 0.f, 1.f, 0.f), glm::vec4(0.f, 0.f, 0.f, 1.f));
-            glUniformMatrix4fv(glGetUniformLocation(m_cloth_texture_shader, "modelMatrix"), 1, GL_FALSE, &identityMatrix[0][0]);
-            glm::mat4 inverseCTM = glm::inverse(identityMatrix); //same thing
-            glUniformMatrix4fv(glGetUniformLocation(m_cloth_texture_shader, "inverseModelMatrix"), 1, GL_FALSE, &inverseCTM[0][0]);
 
-            glDrawElements(GL_TRIANGLES, m_cloth->m_triangleIndices.size(), GL_UNSIGNED_INT, 0);
+            glDrawElements(GL_TRIANGLES, m_clothDrawIndices, GL_UNSIGNED_INT, 0);
 
 
 
@@ -338,11 +365,23 @@ void Realtime::settingsChanged() {
     m_camera->setNearFar(settings.nearPlane, settings.farPlane);
 
 
+    //only a change to what the cloths are built from replaces them, render type, camera or solver
+    //settings keep the running simulation
     if (settings.generateCloth) {
-        delete m_cloth;
-        m_cloth = new Cloth(settings.cloth_width, settings.cloth_length, settings.cloth_width_step, settings.cloth_length_step, 0.0f, glm::vec3(settings.x_clothBottomLeft, settings.y_clothBottomLeft, settings.z_clothBottomLeft));
+        if (clothsMatchSettings()) {
+            for (Cloth *cloth : m_cloths) {
+                cloth->wakeAll(); //forces or friction may have changed under a resting cloth
+            }
+        }
+        else {
+            deleteCloths();
+            createCloths();
+        }
         clothvbovaoGeneration();
     }
+    else {
+        deleteCloths(); //turning cloth back on drops a fresh one
+    }
 
     m_joints[16]->setLocalPosition(settings.headRadius);
     m_joints[3]->setLocalPosition(settings.forearmLength);
@@ -481,12 +520,14 @@ void Realtime::timerEvent(QTimerEvent *event) {
             for (Joint* j : m_joints) {
                 if (j->getName() == "head") {
                     glm::vec3 newSphereTop = 2.f*j->getWorldPosition() - j->getParent()->getWorldPosition();
-                    m_cloth->updateClothPos(newSphereTop, true);
+                    for (Cloth *cloth : m_cloths) {
+                        cloth->updateClothPos(newSphereTop, true);
+                    }
                     break;
                 }
                 // if (j->getName() == "chest") {
                 //     glm::vec3 newSphereTop = j->getWorldPosition();
-                //     m_cloth->updateClothPos(newSphereTop, true);
+                //     m_cloths[0]->updateClothPos(newSphereTop, true);
                 //     break;
                 // }
             }
@@ -523,13 +564,18 @@ void Realtime::timerEvent(QTimerEvent *event) {
     }
 
     if (settings.generateCloth) {
-        simulate(deltaTime);
+        advanceSimulation(deltaTime);
         clothvbovaoGeneration();
     }
 
     update(); // asks for a PaintGL() call to occur
 }
 
+void Realtime::setSolverReportLabel(QLabel *label) {
+    m_solverReportLabel = label;
+    m_solverReportLabel->setVisible(settings.reportSolverIterations);
+}
+
 // DO NOT EDIT
 void Realtime::saveViewportImage(std::string filePath) {
     // Make sure we have the right context and everything has been drawn
@@ -16,13 +16,20 @@
 #include <QTime>
 #include <QTimer>
 #include "utils/sceneparser.h"
+#include "utils/shaderloader.h"
 #include "shapes/Cone.h"
 #include "shapes/Cube.h"
 #include "shapes/Cylinder.h"
 #include "shapes/Sphere.h"
+#include "shapes/MeshCache.h"
 #include "camera/camera.h"
 #include "src/cloth.h"
 #include "src/joint.h"
+#include "src/collider.h"
+#include "src/threadpool.h"
+#include "src/settings.h"
+
+class QLabel;
 
 class Realtime : public QOpenGLWidget
 {
@@ -32,6 +39,7 @@ public:
     void sceneChanged();
     void settingsChanged();
     void saveViewportImage(std::string filePath);
+    void setSolverReportLabel(QLabel *label);            // Where the solver iteration report is shown
 
 public slots:
     void tick(QTimerEvent* event);                      // Called once per tick of m_timer
@@ -50,13 +58,32 @@ private:
     void timerEvent(QTimerEvent *event) override;
 
     //Cloth Methods
+    std::vector<ClothDescriptor> clothDescriptors() const;
+    bool clothsMatchSettings() const;
+    void createCloths();
+    void deleteCloths();
+    void createClothBuffers();
+    void deleteClothBuffers();
     void clothvbovaoGeneration();
+    void advanceSimulation(float frameTime);
     void simulate(float deltaTime);
-    std::vector<glm::vec3> computeForces(float deltaTime);
-    void verletIntegration(std::vector<glm::vec3> forces, float deltaTime);
-    void solveCollisions(int iterations, float deltaTime);
-    void solveClothToClothCollisions(int iterations, float deltaTime);
-    void constrainSprings(int iterations);
+    int stepCloth(Cloth &cloth, float deltaTime);
+    void computeForces(Cloth &cloth, float deltaTime);
+    void verletIntegration(Cloth &cloth, const std::vector<glm::vec3> &forces, float deltaTime);
+    void implicitEulerIntegration(Cloth &cloth, const std::vector<glm::vec3> &forces, float deltaTime);
+    void projectiveIntegration(Cloth &cloth, const std::vector<glm::vec3> &forces, float deltaTime);
+    void projectSpringsPD(Cloth &cloth);
+    void extrapolateIterate(Cloth &cloth, float omega);
+    float maxConstraintViolation(Cloth &cloth, float deltaTime);
+    void buildColliders();
+    void wakeDisturbedTiles(Cloth &cloth);
+    void wakeStretchedTiles(Cloth &cloth);
+    void updateSleeping(Cloth &cloth, float deltaTime);
+    void solveCollisions(Cloth &cloth, int iterations, float deltaTime);
+    void solveClothToClothCollisions(Cloth &cloth, int iterations, float deltaTime);
+    void solveTriangleSelfCollisions(Cloth &cloth);
+    void constrainSprings(Cloth &cloth, int iterations);
+    void projectSpringsXPBD(Cloth &cloth, float deltaTime);
     glm::vec3 friction(glm::vec3 velocity, glm::vec3 normal);
 
     //Cloth Texture
@@ -78,16 +105,19 @@ private:
     // Device Correction Variables
     double m_devicePixelRatio;
 
-    GLuint m_figure_shader; // Stores id of shader program
+    ShaderProgram m_figure_shader; // Stores id of shader program
+    GLint m_figureColorLocation = -1; // uColor of m_figure_shader
+    GLuint m_camera_ubo = 0; // Camera uniform block shared by every program, written once per frame
 
     RenderData m_renderData;
 
     Camera* m_camera;
 
     // Animation
-    GLuint m_lineVAO, m_lineVBO;
-    GLuint m_circleVAO, m_circleVBO;
-    GLuint m_arcVAO, m_arcVBO;
+    GLuint m_skeletonVAO;
+    GLuint m_skeletonVBO; //center and radius per vertex, rewritten every frame
+    GLuint m_skeletonOffsetVBO; //unit circle offset per vertex, static
+    std::vector<glm::vec4> m_skeletonAnchors;
 
     glm::mat4 m_VP;
 
@@ -97,20 +127,45 @@ private:
     std::string m_activeJoint;
 
     std::vector<Joint*> m_joints;
+    std::vector<Collider> m_colliders; //one per sphere or cylinder bone, rebuilt every simulation step
+    glm::vec3 m_headTop = glm::vec3(0.f); //top of the head this step, cloth resting there gets anchored
 
     int m_animType = AnimType::ANIM_NONE;
     bool m_startAnim = false;
     float m_animTime = 0.f;
 
     //Cloth
-    Cloth* m_cloth;
-    GLuint m_cloth_vbo;
-    GLuint m_cloth_vao;
-    GLuint m_spring_vbo;
-    GLuint m_spring_vao;
-    GLuint m_cloth_ebo;
-    GLuint m_cloth_normals_shader;
-    GLuint m_cloth_vertices_shader;
-    GLuint m_cloth_texture_shader;
+    std::vector<Cloth*> m_cloths; //independent garments, stepped in parallel and drawn from one set of buffers
+    GLsizei m_clothDrawVertices = 0; //vertices of every cloth in m_cloth_vbo
+    GLsizei m_clothDrawIndices = 0; //triangle indices of every cloth in m_cloth_ebo
+    GLsizei m_springDrawVertices = 0; //spring endpoint indices of every cloth in m_spring_ebo
+    std::vector<int> m_clothVertexOffsets; //first vertex of each cloth in the packed buffers, plus the total
+    std::vector<int> m_clothSpringOffsets; //first spring of each cloth, plus the total
+    bool m_clothBuffersDirty = true; //cloths were recreated, the buffers no longer match their topology
+    RenderType m_clothBufferRenderType = RenderType::normals; //layout the buffers were created for
+    GLuint m_cloth_vbo = 0; //streamed, positions or positions and normals
+    GLuint m_cloth_uv_vbo = 0; //static
+    GLuint m_cloth_vao = 0;
+    GLuint m_spring_vao = 0; //reads positions from m_cloth_vbo
+    GLuint m_spring_ebo = 0; //static, endpoint indices of every spring
+    GLuint m_spring_type_buffer = 0; //static, one SpringType byte per spring
+    GLuint m_spring_type_texture = 0; //buffer texture over m_spring_type_buffer
+    GLuint m_cloth_ebo = 0; //static
+    ShaderProgram m_cloth_normals_shader;
+    ShaderProgram m_cloth_vertices_shader;
+    ShaderProgram m_cloth_texture_shader;
+    GLint m_colorBySpringTypeLocation = -1; //of m_cloth_vertices_shader, points and springs share the program
+    float m_simAccumulator = 0.f; //wall clock time not yet simulated, less than one fixed step after advanceSimulation
+    size_t m_simulateAllocations = 0; //heap allocations made by the last simulate(), debug builds only
+    size_t m_frameAllocations = 0; //summed over every simulate() of the last advanceSimulation
+    bool m_loggedSimulateAllocations = false; //only the first allocating step is logged
+    int m_lastSolverIterations = 0; //constraint and collision passes the last simulate() ran, most of any cloth
+    int m_frameSolverIterations = 0; //summed over every simulate() of the last advanceSimulation
+    QLabel *m_solverReportLabel = nullptr; //sidebar label for the solver iteration report, owned by MainWindow
+    int m_reportIterations = 0; //solver passes since the report was last shown
+    size_t m_reportAllocations = 0; //simulate() heap allocations since the report was last shown, debug builds only
+    int m_reportSteps = 0; //simulate() calls since the report was last shown
+    float m_reportTime = 0.f; //frame time since the report was last shown
+    ThreadPool m_threadPool{settings.simulationThreads}; //shared by the solver and render prep
 
 };
@@ -10,6 +10,13 @@ enum class RenderType {
     texture
 };
 
+enum class SolverType {
+    massSpring, //explicit hooke forces plus a 10% stretch limit
+    xpbd,       //compliant distance constraints, stiffness independent of iterations and timestep
+    implicitEuler, //mass spring with backward euler integration, stable at high k without smaller steps
+    projectiveDynamics //local/global spring projection against a prefactored system matrix
+};
+
 struct Settings {
     std::string sceneFilePath;
     int shapeParameter1 = 25;
@@ -43,15 +50,51 @@ struct Settings {
     float cloth_width_step = 0.3f;
     float cloth_length = 2.f; //depth
     float cloth_length_step = 0.3f;
+    int clothCount = 1; //independent cloths, stacked in layers
+    float clothLayerSpacing = 0.3f; //height between one cloth layer and the next
 
     float mu_static = 0.5f; //static friction  0.5f;
     float mu_kinetic = 0.9f; //kinetic friction 0.3f
 
     float clothToShapeCollisionCorrection = 0.500f; // for cloth to shape collisions
+    float boneRadius = 0.3f; //capsule radius of the limb and body bones
+    bool continuousCollisions = true; //sweep vertices against the bones' motion so fast limbs do not pass through the cloth
 
     //for cloth to cloth collisions
     float clothVertexRadius;
     float clothToClothCollisionCorrection = 0.001;
+    bool useSpatialHash = true; //false falls back to brute force vertex pairs, for comparison
+    bool triangleSelfCollision = false; //point-triangle and edge-edge contacts instead of vertex spheres
+    float clothThickness = 0.02f; //minimum distance kept between unconnected triangles
+
+    //island sleeping, tiles of cloth that stay still are frozen until a moving bone or a stretched spring wakes them
+    bool clothSleeping = true;
+    float sleepEnergy = 2.5e-4f; //kinetic energy per vertex below which a tile counts as still, about 1cm/s at the default mass
+    int sleepSteps = 30; //still steps in a row before a tile sleeps
+    float wakeStretch = 0.15f; //relative stretch of a spring into a sleeping tile that wakes it, measured before the spring passes clamp it to 10%
+
+    //fixed timestep, wall clock time is accumulated and consumed in steps of fixedTimeStep
+    float fixedTimeStep = 1.f / 60.f;
+    int substeps = 1; //simulate() calls per fixed step, each advancing fixedTimeStep / substeps
+    int maxCatchUpSteps = 4; //fixed steps per frame at most, time beyond that is dropped after a hitch
+
+    SolverType solverType = SolverType::massSpring;
+    int solverIterations = 5; //constraint and collision passes per step, the most the adaptive loop may run
+    bool adaptiveIterations = false; //stop the passes early once the largest constraint violation is below solverTolerance
+    int minSolverIterations = 2; //passes always run before the adaptive loop may stop
+    float solverTolerance = 0.01f; //largest constraint violation, relative to the rest length, that counts as converged
+    bool reportSolverIterations = false; //show the passes per step of the slowest cloth in the sidebar, averaged over about a second, and any heap allocations of the step in debug builds
+    bool chebyshevAcceleration = false; //extrapolate the spring passes along the chebyshev sequence, collisions are not extrapolated
+    float chebyshevRho = 0.9f; //estimated spectral radius of one spring pass, closer to 1 extrapolates harder
+    int chebyshevDelay = 1; //plain iterations before extrapolation starts, at least 1
+    float xpbdComplianceScale = 0.001f; //xpbd compliance is this over the spring k, the mass spring stretch limit is much stiffer than k itself
+    int cgMaxIterations = 50; //conjugate gradient iterations per step at most, implicit euler only
+    float cgTolerance = 1e-3f; //residual relative to the right hand side at which conjugate gradient stops
+    float pdStiffnessScale = 1000.f; //projective dynamics spring weight is k times this, changing it refactors the system
+
+    //parallel solver
+    int simulationThreads = 0; //threads in the pool, 0 uses every hardware thread, read at startup
+    int parallelGrainSize = 1024; //smallest range a parallel loop hands to one thread
 
     RenderType renderType = RenderType::normals;
 
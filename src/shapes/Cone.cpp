@@ -1,66 +1,34 @@
 #include "Cone.h"
 
 void Cone::updateParams(int param1, int param2) {
-    m_vertexData = std::vector<float>();
+    if (param1 == m_param1 && param2 == m_param2 && !m_vertexData.empty()) {
+        return;
+    }
     m_param1 = param1;
     m_param2 = param2;
     setVertexData();
 }
 
-void Cone::makeCapCorner(glm::vec3 top,
-                         glm::vec3 bottomLeft,
-                         glm::vec3 bottomRight) {
-    glm::vec3 normal = glm::vec3(0.f, -1.f, 0.f);
-    insertVec3(m_vertexData, top);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, bottomLeft);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, normal);
-}
-
-void Cone::makeCapTile(glm::vec3 topLeft,
-                       glm::vec3 topRight,
-                       glm::vec3 bottomLeft,
-                       glm::vec3 bottomRight) {
+// center followed by param1 rings of param2 vertices, all facing down
+unsigned int Cone::makeCap() {
+    unsigned int center = m_vertexData.size() / 6;
     glm::vec3 normal = glm::vec3(0.f, -1.f, 0.f);
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, topRight);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, bottomLeft);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, bottomRight);
+    insertVec3(m_vertexData, glm::vec3(0.f, -0.5f, 0.f));
     insertVec3(m_vertexData, normal);
+    for (int i = 1; i <= m_param1; i++) {
+        for (int j = 0; j < m_param2; j++) {
+            float theta = j * 2*M_PI / m_param2;
+            insertVec3(m_vertexData, glm::vec3(i * 0.5f / m_param1 * glm::cos(theta),
+                                               -0.5f,
+                                               i * 0.5f / m_param1 * glm::sin(theta)));
+            insertVec3(m_vertexData, normal);
+        }
+    }
+    return center;
 }
 
-void Cone::makeCapSlice(float currentTheta, float nextTheta){
-    glm::vec3 bl = glm::vec3(0.5f / m_param1 * glm::cos(nextTheta),
-                             -0.5f,
-                             0.5f / m_param1 * glm::sin(nextTheta));
-    glm::vec3 br = glm::vec3(0.5f / m_param1 * glm::cos(currentTheta),
-                             -0.5f,
-                             0.5f / m_param1 * glm::sin(currentTheta));
-    makeCapCorner(glm::vec3(0.f, -0.5f, 0.f), bl, br);
-    for (int i = 1; i < m_param1; i++) {
-        glm::vec3 tl = glm::vec3(i * 0.5f / m_param1 * glm::cos(nextTheta),
-                                 -0.5f,
-                                 i * 0.5f / m_param1 * glm::sin(nextTheta));
-        glm::vec3 tr = glm::vec3(i * 0.5f / m_param1 * glm::cos(currentTheta),
-                                 -0.5f,
-                                 i * 0.5f / m_param1 * glm::sin(currentTheta));
-        glm::vec3 bl = glm::vec3((i+1) * 0.5f / m_param1 * glm::cos(nextTheta),
-                                 -0.5f,
-                                 (i+1) * 0.5f / m_param1 * glm::sin(nextTheta));
-        glm::vec3 br = glm::vec3((i+1) * 0.5f / m_param1 * glm::cos(currentTheta),
-                                 -0.5f,
-                                 (i+1) * 0.5f / m_param1 * glm::sin(currentTheta));
-        makeCapTile(tl, tr, bl, br);
-    }
+unsigned int Cone::capVertex(int ring, int thetaIndex) {
+    return m_cap + 1 + (ring - 1) * m_param2 + thetaIndex % m_param2;
 }
 
 glm::vec3 Cone::calcNorm(glm::vec3& pt) {
@@ -71,75 +39,83 @@ glm::vec3 Cone::calcNorm(glm::vec3& pt) {
     return glm::normalize(glm::vec3{ xNorm, yNorm, zNorm });
 }
 
-void Cone::makeSlopeCorner(glm::vec3 top,
-                           glm::vec3 bottomLeft,
-                           glm::vec3 bottomRight) {
-    glm::vec3 blNormal = calcNorm(bottomLeft);
-    glm::vec3 brNormal = calcNorm(bottomRight);
-    insertVec3(m_vertexData, top);
-    insertVec3(m_vertexData, 0.5f * (blNormal + brNormal));
-    insertVec3(m_vertexData, bottomLeft);
-    insertVec3(m_vertexData, blNormal);
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, brNormal);
+glm::vec3 Cone::slopePoint(int ring, int thetaIndex) {
+    float theta = thetaIndex * 2*M_PI / m_param2;
+    return glm::vec3(0.5f*ring/m_param1 * cos(theta),
+                     0.5f - (float)ring/m_param1,
+                     0.5f*ring/m_param1 * sin(theta));
 }
 
-void Cone::makeSlopeTile(glm::vec3 topLeft,
-                         glm::vec3 topRight,
-                         glm::vec3 bottomLeft,
-                         glm::vec3 bottomRight) {
-    glm::vec3 leftNorm = calcNorm(topLeft);
-    glm::vec3 rightNorm = calcNorm(topRight);
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, leftNorm);
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, rightNorm);
-    insertVec3(m_vertexData, topRight);
-    insertVec3(m_vertexData, rightNorm);
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, leftNorm);
-    insertVec3(m_vertexData, bottomLeft);
-    insertVec3(m_vertexData, leftNorm);
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, rightNorm);
+// the tip has no single normal, so each wedge gets its own tip vertex with the average of the normals
+// below it, followed by param1 rings of param2 vertices from the tip down
+unsigned int Cone::makeSlope() {
+    unsigned int first = m_vertexData.size() / 6;
+    for (int j = 0; j < m_param2; j++) {
+        glm::vec3 bl = slopePoint(1, j + 1);
+        glm::vec3 br = slopePoint(1, j);
+        insertVec3(m_vertexData, glm::vec3(0.f, 0.5f, 0.f));
+        insertVec3(m_vertexData, 0.5f * (calcNorm(bl) + calcNorm(br)));
+    }
+    for (int i = 1; i <= m_param1; i++) {
+        for (int j = 0; j < m_param2; j++) {
+            glm::vec3 pt = slopePoint(i, j);
+            insertVec3(m_vertexData, pt);
+            insertVec3(m_vertexData, calcNorm(pt));
+        }
+    }
+    return first;
 }
 
-void Cone::makeSlopeSlice(float currentTheta, float nextTheta){
-    glm::vec3 bl = glm::vec3(0.5f/m_param1 * cos(currentTheta),
-                             0.5f - 1.f/m_param1,
-                             0.5f/m_param1 * sin(currentTheta));
-    glm::vec3 br = glm::vec3(0.5f/m_param1 * cos(nextTheta),
-                             0.5f - 1.f/m_param1,
-                             0.5f/m_param1 * sin(nextTheta));
-    makeSlopeCorner(glm::vec3(0.f, 0.5f, 0.f), bl, br);
+unsigned int Cone::slopeVertex(int ring, int thetaIndex) {
+    return m_slope + ring * m_param2 + thetaIndex % m_param2;
+}
+
+// wedge between thetaIndex and thetaIndex + 1, wound the same way the triangle soup used to be
+void Cone::makeWedge(int thetaIndex) {
+    int curr = thetaIndex + 1;
+    int next = thetaIndex;
+
+    makeTriangle(m_cap, capVertex(1, next), capVertex(1, curr));
     for (int i = 1; i < m_param1; i++) {
-        glm::vec3 tl = glm::vec3(0.5f*i/m_param1 * cos(currentTheta),
-                                 0.5f - (float)i/m_param1,
-                                 0.5f*i/m_param1 * sin(currentTheta));
-        glm::vec3 tr = glm::vec3(0.5f*i/m_param1 * cos(nextTheta),
-                                 0.5f - (float)i/m_param1,
-                                 0.5f*i/m_param1 * sin(nextTheta));
-        bl = glm::vec3(0.5f*(i+1)/m_param1 * cos(currentTheta),
-                       0.5f - (float)(i+1)/m_param1,
-                       0.5f*(i+1)/m_param1 * sin(currentTheta));
-        br = glm::vec3(0.5f*(i+1)/m_param1 * cos(nextTheta),
-                       0.5f - (float)(i+1)/m_param1,
-                       0.5f*(i+1)/m_param1 * sin(nextTheta));
-        makeSlopeTile(tl, tr, bl, br);
+        unsigned int tl = capVertex(i, next);
+        unsigned int tr = capVertex(i, curr);
+        unsigned int bl = capVertex(i + 1, next);
+        unsigned int br = capVertex(i + 1, curr);
+        makeTriangle(tl, br, tr);
+        makeTriangle(tl, bl, br);
     }
-}
 
-void Cone::makeWedge(float currentTheta, float nextTheta) {
-    makeCapSlice(currentTheta, nextTheta);
-    makeSlopeSlice(currentTheta, nextTheta);
+    makeTriangle(m_slope + thetaIndex, slopeVertex(1, curr), slopeVertex(1, next));
+    for (int i = 1; i < m_param1; i++) {
+        unsigned int tl = slopeVertex(i, curr);
+        unsigned int tr = slopeVertex(i, next);
+        unsigned int bl = slopeVertex(i + 1, curr);
+        unsigned int br = slopeVertex(i + 1, next);
+        makeTriangle(tl, br, tr);
+        makeTriangle(tl, bl, br);
+    }
 }
 
 void Cone::setVertexData() {
+    int wedgeTriangles = 2 * (1 + 2 * (m_param1 - 1));
+    m_vertexData.clear();
+    m_vertexData.reserve(6 * (1 + m_param2 + 2 * m_param1 * m_param2));
+    m_indices.clear();
+    m_indices.reserve(3 * wedgeTriangles * m_param2);
+
+    m_cap = makeCap();
+    m_slope = makeSlope();
     for (int i = 0; i < m_param2; i++) {
-        makeWedge((i+1) * 2*M_PI / m_param2, i * 2*M_PI / m_param2);
+        makeWedge(i);
     }
 }
 
+void Cone::makeTriangle(unsigned int a, unsigned int b, unsigned int c) {
+    m_indices.push_back(a);
+    m_indices.push_back(b);
+    m_indices.push_back(c);
+}
+
 void Cone::insertVec3(std::vector<float> &data, glm::vec3 v) {
     data.push_back(v.x);
     data.push_back(v.y);
@@ -7,33 +7,27 @@ class Cone
 {
 public:
     void updateParams(int param1, int param2);
-    std::vector<float> generateShape() { return m_vertexData; }
+    const std::vector<float> &generateShape() { return m_vertexData; }
+    const std::vector<unsigned int> &generateIndices() { return m_indices; }
     int dataLen() { return m_vertexData.size(); }
 
 private:
     void insertVec3(std::vector<float> &data, glm::vec3 v);
+    void makeTriangle(unsigned int a, unsigned int b, unsigned int c);
     void setVertexData();
-    void makeCapCorner(glm::vec3 top,
-                       glm::vec3 bottomLeft,
-                       glm::vec3 bottomRight);
-    void makeCapTile(glm::vec3 topLeft,
-                     glm::vec3 topRight,
-                     glm::vec3 bottomLeft,
-                     glm::vec3 bottomRight);
-    void makeCapSlice(float currentTheta, float nextTheta);
+    unsigned int makeCap();
+    unsigned int capVertex(int ring, int thetaIndex);
     glm::vec3 calcNorm(glm::vec3& pt);
-    void makeSlopeCorner(glm::vec3 top,
-                         glm::vec3 bottomLeft,
-                         glm::vec3 bottomRight);
-    void makeSlopeTile(glm::vec3 topLeft,
-                       glm::vec3 topRight,
-                       glm::vec3 bottomLeft,
-                       glm::vec3 bottomRight);
-    void makeSlopeSlice(float currentTheta, float nextTheta);
-    void makeWedge(float currentTheta, float nextTheta);
+    glm::vec3 slopePoint(int ring, int thetaIndex);
+    unsigned int makeSlope();
+    unsigned int slopeVertex(int ring, int thetaIndex);
+    void makeWedge(int thetaIndex);
 
-    std::vector<float> m_vertexData;
-    int m_param1;
-    int m_param2;
+    std::vector<float> m_vertexData; //position and normal of every distinct vertex
+    std::vector<unsigned int> m_indices; //three per triangle
+    unsigned int m_cap = 0; //index of the center of the bottom cap, its rings follow
+    unsigned int m_slope = 0; //first of the param2 tip vertices, the slope rings follow
+    int m_param1 = 0;
+    int m_param2 = 0;
     float m_radius = 0.5;
 };
@@ -1,47 +1,49 @@
 #include "Cube.h"
 
 void Cube::updateParams(int param1) {
-    m_vertexData = std::vector<float>();
+    if (param1 == m_param1 && !m_vertexData.empty()) {
+        return;
+    }
     m_param1 = param1;
     setVertexData();
 }
 
-void Cube::makeTile(glm::vec3 topLeft,
-                    glm::vec3 topRight,
-                    glm::vec3 bottomLeft,
-                    glm::vec3 bottomRight) {
-    glm::vec3 normal = glm::normalize(glm::cross(bottomRight-topLeft, topRight-topLeft));
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, topRight);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, bottomLeft);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, normal);
-}
-
+// a (param1 + 1) x (param1 + 1) grid of vertices, faces share no vertex since their normals differ
 void Cube::makeFace(glm::vec3 topLeft,
                     glm::vec3 topRight,
                     glm::vec3 bottomLeft,
                     glm::vec3 bottomRight) {
     glm::vec3 top = topRight - topLeft;
     glm::vec3 left = bottomLeft - topLeft;
+    glm::vec3 normal = glm::normalize(glm::cross(bottomRight-topLeft, topRight-topLeft));
+
+    unsigned int first = m_vertexData.size() / 6;
+    int side = m_param1 + 1;
+    for (int i = 0; i <= m_param1; i++) {
+        for (int j = 0; j <= m_param1; j++) {
+            insertVec3(m_vertexData, topLeft + (float)i/m_param1 * top + (float)j/m_param1 * left);
+            insertVec3(m_vertexData, normal);
+        }
+    }
+
     for (int i = 0; i < m_param1; i++) {
         for (int j = 0; j < m_param1; j++) {
-            makeTile(topLeft + (float)i/m_param1 * top + (float)j/m_param1 * left,
-                     topLeft + (float)(i+1)/m_param1 * top + (float)j/m_param1 * left,
-                     topLeft + (float)i/m_param1 * top + (float)(j+1)/m_param1 * left,
-                     topLeft + (float)(i+1)/m_param1 * top + (float)(j+1)/m_param1 * left);
+            unsigned int tl = first + i * side + j;
+            unsigned int tr = first + (i+1) * side + j;
+            unsigned int bl = tl + 1;
+            unsigned int br = tr + 1;
+            makeTriangle(tl, br, tr);
+            makeTriangle(tl, bl, br);
         }
     }
 }
 
 void Cube::setVertexData() {
+    m_vertexData.clear();
+    m_vertexData.reserve(6 * 6 * (m_param1 + 1) * (m_param1 + 1));
+    m_indices.clear();
+    m_indices.reserve(6 * 6 * m_param1 * m_param1);
+
     makeFace(glm::vec3(-0.5f,  0.5f, 0.5f),
              glm::vec3( 0.5f,  0.5f, 0.5f),
              glm::vec3(-0.5f, -0.5f, 0.5f),
@@ -68,6 +70,12 @@ void Cube::setVertexData() {
              glm::vec3(-0.5f, -0.5f, 0.5f));
 }
 
+void Cube::makeTriangle(unsigned int a, unsigned int b, unsigned int c) {
+    m_indices.push_back(a);
+    m_indices.push_back(b);
+    m_indices.push_back(c);
+}
+
 void Cube::insertVec3(std::vector<float> &data, glm::vec3 v) {
     data.push_back(v.x);
     data.push_back(v.y);
@@ -7,21 +7,20 @@ class Cube
 {
 public:
     void updateParams(int param1);
-    std::vector<float> generateShape() { return m_vertexData; }
+    const std::vector<float> &generateShape() { return m_vertexData; }
+    const std::vector<unsigned int> &generateIndices() { return m_indices; }
     int dataLen() { return m_vertexData.size(); }
 
 private:
     void insertVec3(std::vector<float> &data, glm::vec3 v);
+    void makeTriangle(unsigned int a, unsigned int b, unsigned int c);
     void setVertexData();
-    void makeTile(glm::vec3 topLeft,
-                  glm::vec3 topRight,
-                  glm::vec3 bottomLeft,
-                  glm::vec3 bottomRight);
     void makeFace(glm::vec3 topLeft,
                   glm::vec3 topRight,
                   glm::vec3 bottomLeft,
                   glm::vec3 bottomRight);
 
-    std::vector<float> m_vertexData;
-    int m_param1;
+    std::vector<float> m_vertexData; //position and normal of every distinct vertex
+    std::vector<unsigned int> m_indices; //three per triangle
+    int m_param1 = 0;
 };
@@ -1,74 +1,34 @@
 #include "Cylinder.h"
 
 void Cylinder::updateParams(int param1, int param2) {
-    m_vertexData = std::vector<float>();
+    if (param1 == m_param1 && param2 == m_param2 && !m_vertexData.empty()) {
+        return;
+    }
     m_param1 = param1;
     m_param2 = param2;
     setVertexData();
 }
 
-void Cylinder::makeCapCorner(glm::vec3 top,
-                         glm::vec3 bottomLeft,
-                         glm::vec3 bottomRight) {
-    glm::vec3 normal = glm::vec3(0.f, top.y / std::abs(top.y), 0.f);
-    insertVec3(m_vertexData, top);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, bottomLeft);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, normal);
-}
-
-void Cylinder::makeCapTile(glm::vec3 topLeft,
-                       glm::vec3 topRight,
-                       glm::vec3 bottomLeft,
-                       glm::vec3 bottomRight) {
-    glm::vec3 normal = glm::vec3(0.f, topLeft.y / std::abs(topLeft.y), 0.f);
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, topRight);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, bottomLeft);
-    insertVec3(m_vertexData, normal);
-    insertVec3(m_vertexData, bottomRight);
+// center followed by param1 rings of param2 vertices, all facing straight up or down
+unsigned int Cylinder::makeCap(float y) {
+    unsigned int center = m_vertexData.size() / 6;
+    glm::vec3 normal = glm::vec3(0.f, y / std::abs(y), 0.f);
+    insertVec3(m_vertexData, glm::vec3(0.f, y, 0.f));
     insertVec3(m_vertexData, normal);
+    for (int i = 1; i <= m_param1; i++) {
+        for (int j = 0; j < m_param2; j++) {
+            float theta = j * 2*M_PI / m_param2;
+            insertVec3(m_vertexData, glm::vec3(i * 0.5f / m_param1 * glm::cos(theta),
+                                               y,
+                                               i * 0.5f / m_param1 * glm::sin(theta)));
+            insertVec3(m_vertexData, normal);
+        }
+    }
+    return center;
 }
 
-void Cylinder::makeCapSlice(float currentTheta, float nextTheta){
-    glm::vec3 bl = glm::vec3(0.5f / m_param1 * glm::cos(nextTheta),
-                             -0.5f,
-                             0.5f / m_param1 * glm::sin(nextTheta));
-    glm::vec3 br = glm::vec3(0.5f / m_param1 * glm::cos(currentTheta),
-                             -0.5f,
-                             0.5f / m_param1 * glm::sin(currentTheta));
-    makeCapCorner(glm::vec3(0.f, -0.5f, 0.f), bl, br);
-    bl.y = 0.5f;
-    br.y = 0.5f;
-    makeCapCorner(glm::vec3(0.f, 0.5f, 0.f), br, bl);
-    for (int i = 1; i < m_param1; i++) {
-        glm::vec3 tl = glm::vec3(i * 0.5f / m_param1 * glm::cos(nextTheta),
-                                 -0.5f,
-                                 i * 0.5f / m_param1 * glm::sin(nextTheta));
-        glm::vec3 tr = glm::vec3(i * 0.5f / m_param1 * glm::cos(currentTheta),
-                                 -0.5f,
-                                 i * 0.5f / m_param1 * glm::sin(currentTheta));
-        glm::vec3 bl = glm::vec3((i+1) * 0.5f / m_param1 * glm::cos(nextTheta),
-                                 -0.5f,
-                                 (i+1) * 0.5f / m_param1 * glm::sin(nextTheta));
-        glm::vec3 br = glm::vec3((i+1) * 0.5f / m_param1 * glm::cos(currentTheta),
-                                 -0.5f,
-                                 (i+1) * 0.5f / m_param1 * glm::sin(currentTheta));
-        makeCapTile(tl, tr, bl, br);
-        tl.y = 0.5f;
-        tr.y = 0.5f;
-        bl.y = 0.5f;
-        br.y = 0.5f;
-        makeCapTile(tr, tl, br, bl);
-    }
+unsigned int Cylinder::capVertex(unsigned int cap, int ring, int thetaIndex) {
+    return cap + 1 + (ring - 1) * m_param2 + thetaIndex % m_param2;
 }
 
 glm::vec3 Cylinder::calcNorm(glm::vec3& pt) {
@@ -79,55 +39,81 @@ glm::vec3 Cylinder::calcNorm(glm::vec3& pt) {
     return glm::normalize(glm::vec3{ xNorm, yNorm, zNorm });
 }
 
-void Cylinder::makeSideTile(glm::vec3 topLeft,
-                            glm::vec3 topRight,
-                            glm::vec3 bottomLeft,
-                            glm::vec3 bottomRight) {
-    glm::vec3 leftNorm = calcNorm(topLeft);
-    glm::vec3 rightNorm = calcNorm(topRight);
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, leftNorm);
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, rightNorm);
-    insertVec3(m_vertexData, topRight);
-    insertVec3(m_vertexData, rightNorm);
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, leftNorm);
-    insertVec3(m_vertexData, bottomLeft);
-    insertVec3(m_vertexData, leftNorm);
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, rightNorm);
+// param1 + 1 rows of param2 vertices from the top edge down, separate from the caps since the normals differ
+unsigned int Cylinder::makeSide() {
+    unsigned int first = m_vertexData.size() / 6;
+    for (int i = 0; i <= m_param1; i++) {
+        for (int j = 0; j < m_param2; j++) {
+            float theta = j * 2*M_PI / m_param2;
+            glm::vec3 pt = glm::vec3(0.5f * cos(theta),
+                                     0.5f - (float)i/m_param1,
+                                     0.5f * sin(theta));
+            insertVec3(m_vertexData, pt);
+            insertVec3(m_vertexData, calcNorm(pt));
+        }
+    }
+    return first;
 }
 
-void Cylinder::makeSideSlice(float currentTheta, float nextTheta){
-    for (int i = 0; i < m_param1; i++) {
-        glm::vec3 tl = glm::vec3(0.5f * cos(currentTheta),
-                                 0.5f - (float)i/m_param1,
-                                 0.5f * sin(currentTheta));
-        glm::vec3 tr = glm::vec3(0.5f * cos(nextTheta),
-                                 0.5f - (float)i/m_param1,
-                                 0.5f * sin(nextTheta));
-        glm::vec3 bl = glm::vec3(0.5f * cos(currentTheta),
-                                 0.5f - (float)(i+1)/m_param1,
-                                 0.5f * sin(currentTheta));
-        glm::vec3 br = glm::vec3(0.5f * cos(nextTheta),
-                                 0.5f - (float)(i+1)/m_param1,
-                                 0.5f * sin(nextTheta));
-        makeSideTile(tl, tr, bl, br);
-    }
+unsigned int Cylinder::sideVertex(int row, int thetaIndex) {
+    return m_side + row * m_param2 + thetaIndex % m_param2;
 }
 
-void Cylinder::makeWedge(float currentTheta, float nextTheta) {
-    makeCapSlice(currentTheta, nextTheta);
-    makeSideSlice(currentTheta, nextTheta);
+// wedge between thetaIndex and thetaIndex + 1, wound the same way the triangle soup used to be
+void Cylinder::makeWedge(int thetaIndex) {
+    int curr = thetaIndex + 1;
+    int next = thetaIndex;
+
+    makeTriangle(m_bottomCap, capVertex(m_bottomCap, 1, next), capVertex(m_bottomCap, 1, curr));
+    makeTriangle(m_topCap, capVertex(m_topCap, 1, curr), capVertex(m_topCap, 1, next));
+    for (int i = 1; i < m_param1; i++) {
+        unsigned int tl = capVertex(m_bottomCap, i, next);
+        unsigned int tr = capVertex(m_bottomCap, i, curr);
+        unsigned int bl = capVertex(m_bottomCap, i + 1, next);
+        unsigned int br = capVertex(m_bottomCap, i + 1, curr);
+        makeTriangle(tl, br, tr);
+        makeTriangle(tl, bl, br);
+
+        tl = capVertex(m_topCap, i, next);
+        tr = capVertex(m_topCap, i, curr);
+        bl = capVertex(m_topCap, i + 1, next);
+        br = capVertex(m_topCap, i + 1, curr);
+        makeTriangle(tr, bl, tl);
+        makeTriangle(tr, br, bl);
+    }
+
+    for (int i = 0; i < m_param1; i++) {
+        unsigned int tl = sideVertex(i, curr);
+        unsigned int tr = sideVertex(i, next);
+        unsigned int bl = sideVertex(i + 1, curr);
+        unsigned int br = sideVertex(i + 1, next);
+        makeTriangle(tl, br, tr);
+        makeTriangle(tl, bl, br);
+    }
 }
 
 void Cylinder::setVertexData() {
+    int capVertices = 1 + m_param1 * m_param2;
+    int capTriangles = m_param2 + 2 * (m_param1 - 1) * m_param2;
+    m_vertexData.clear();
+    m_vertexData.reserve(6 * (2 * capVertices + (m_param1 + 1) * m_param2));
+    m_indices.clear();
+    m_indices.reserve(3 * (2 * capTriangles + 2 * m_param1 * m_param2));
+
+    m_bottomCap = makeCap(-0.5f);
+    m_topCap = makeCap(0.5f);
+    m_side = makeSide();
     for (int i = 0; i < m_param2; i++) {
-        makeWedge((i+1) * 2*M_PI / m_param2, i * 2*M_PI / m_param2);
+        makeWedge(i);
     }
 }
 
+void Cylinder::makeTriangle(unsigned int a, unsigned int b, unsigned int c) {
+    m_indices.push_back(a);
+    m_indices.push_back(b);
+    m_indices.push_back(c);
+}
+
 void Cylinder::insertVec3(std::vector<float> &data, glm::vec3 v) {
     data.push_back(v.x);
     data.push_back(v.y);
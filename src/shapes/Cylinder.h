@@ -7,30 +7,27 @@ class Cylinder
 {
 public:
     void updateParams(int param1, int param2);
-    std::vector<float> generateShape() { return m_vertexData; }
+    const std::vector<float> &generateShape() { return m_vertexData; }
+    const std::vector<unsigned int> &generateIndices() { return m_indices; }
     int dataLen() { return m_vertexData.size(); }
 
 private:
     void insertVec3(std::vector<float> &data, glm::vec3 v);
+    void makeTriangle(unsigned int a, unsigned int b, unsigned int c);
     void setVertexData();
-    void makeCapCorner(glm::vec3 top,
-                       glm::vec3 bottomLeft,
-                       glm::vec3 bottomRight);
-    void makeCapTile(glm::vec3 topLeft,
-                     glm::vec3 topRight,
-                     glm::vec3 bottomLeft,
-                     glm::vec3 bottomRight);
-    void makeCapSlice(float currentTheta, float nextTheta);
+    unsigned int makeCap(float y);
+    unsigned int capVertex(unsigned int cap, int ring, int thetaIndex);
+    unsigned int makeSide();
+    unsigned int sideVertex(int row, int thetaIndex);
     glm::vec3 calcNorm(glm::vec3& pt);
-    void makeSideTile(glm::vec3 topLeft,
-                      glm::vec3 topRight,
-                      glm::vec3 bottomLeft,
-                      glm::vec3 bottomRight);
-    void makeSideSlice(float currentTheta, float nextTheta);
-    void makeWedge(float currentTheta, float nextTheta);
+    void makeWedge(int thetaIndex);
 
-    std::vector<float> m_vertexData;
-    int m_param1;
-    int m_param2;
+    std::vector<float> m_vertexData; //position and normal of every distinct vertex
+    std::vector<unsigned int> m_indices; //three per triangle
+    unsigned int m_bottomCap = 0; //index of the center of each cap, its rings follow
+    unsigned int m_topCap = 0;
+    unsigned int m_side = 0; //first vertex of the side, param1 + 1 rows of param2
+    int m_param1 = 0;
+    int m_param2 = 0;
     float m_radius = 0.5;
 };
@@ -0,0 +1,87 @@
+#include "MeshCache.h"
+#include "Cone.h"
+#include "Cube.h"
+#include "Cylinder.h"
+#include "Sphere.h"
+
+std::map<MeshCache::Key, ShapeMesh> MeshCache::s_meshes;
+
+const ShapeMesh &MeshCache::get(PrimitiveType type, int param1, int param2) {
+    // the cube only has one parameter
+    if (type == PrimitiveType::PRIMITIVE_CUBE) {
+        param2 = 0;
+    }
+
+    Key key(type, param1, param2);
+    auto it = s_meshes.find(key);
+    if (it != s_meshes.end()) {
+        return it->second;
+    }
+
+    ShapeMesh mesh;
+    switch (type) {
+    case PrimitiveType::PRIMITIVE_CUBE: {
+        Cube cube;
+        cube.updateParams(param1);
+        mesh = upload(cube.generateShape(), cube.generateIndices());
+        break;
+    }
+    case PrimitiveType::PRIMITIVE_CONE: {
+        Cone cone;
+        cone.updateParams(param1, param2);
+        mesh = upload(cone.generateShape(), cone.generateIndices());
+        break;
+    }
+    case PrimitiveType::PRIMITIVE_CYLINDER: {
+        Cylinder cylinder;
+        cylinder.updateParams(param1, param2);
+        mesh = upload(cylinder.generateShape(), cylinder.generateIndices());
+        break;
+    }
+    case PrimitiveType::PRIMITIVE_SPHERE: {
+        Sphere sphere;
+        sphere.updateParams(param1, param2);
+        mesh = upload(sphere.generateShape(), sphere.generateIndices());
+        break;
+    }
+    default: // triangle meshes are not tessellated, an empty mesh draws nothing
+        break;
+    }
+
+    return s_meshes.emplace(key, mesh).first->second;
+}
+
+void MeshCache::clear() {
+    for (auto &[key, mesh] : s_meshes) {
+        glDeleteBuffers(1, &mesh.vbo);
+        glDeleteBuffers(1, &mesh.ebo);
+        glDeleteVertexArrays(1, &mesh.vao);
+    }
+    s_meshes.clear();
+}
+
+ShapeMesh MeshCache::upload(const std::vector<float> &vertexData, const std::vector<unsigned int> &indices) {
+    ShapeMesh mesh;
+    mesh.indexCount = indices.size();
+
+    glGenVertexArrays(1, &mesh.vao);
+    glBindVertexArray(mesh.vao);
+
+    glGenBuffers(1, &mesh.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), reinterpret_cast<void*>(0));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), reinterpret_cast<void*>(3 * sizeof(GLfloat)));
+
+    glGenBuffers(1, &mesh.ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), indices.data(), GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return mesh;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <map>
+#include <tuple>
+#include "utils/scenedata.h"
+
+// GPU copy of one tessellated primitive: interleaved position and normal at locations 0 and 1,
+// drawn with glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0)
+struct ShapeMesh {
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ebo = 0;
+    GLsizei indexCount = 0;
+};
+
+// Process wide cache, every primitive of the same type and tessellation shares one set of buffers.
+// Needs the GL context current, and clear() must run before that context goes away.
+class MeshCache
+{
+public:
+    static const ShapeMesh &get(PrimitiveType type, int param1, int param2);
+    static void clear();
+
+private:
+    using Key = std::tuple<PrimitiveType, int, int>;
+
+    static ShapeMesh upload(const std::vector<float> &vertexData, const std::vector<unsigned int> &indices);
+
+    static std::map<Key, ShapeMesh> s_meshes;
+};
@@ -1,60 +1,85 @@
 #include "Sphere.h"
+#include <algorithm>
 
 void Sphere::updateParams(int param1, int param2) {
-    m_vertexData = std::vector<float>();
+    if (param1 == m_param1 && param2 == m_param2 && !m_vertexData.empty()) {
+        return;
+    }
     m_param1 = param1;
     m_param2 = param2;
     setVertexData();
 }
 
-void Sphere::makeTile(glm::vec3 topLeft,
-                      glm::vec3 topRight,
-                      glm::vec3 bottomLeft,
-                      glm::vec3 bottomRight) {
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, glm::normalize(topLeft));
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, glm::normalize(bottomRight));
-    insertVec3(m_vertexData, topRight);
-    insertVec3(m_vertexData, glm::normalize(topRight));
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, glm::normalize(topLeft));
-    insertVec3(m_vertexData, bottomLeft);
-    insertVec3(m_vertexData, glm::normalize(bottomLeft));
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, glm::normalize(bottomRight));
-}
-
-void Sphere::makeWedge(float currentTheta, float nextTheta) {
+// vertex 0 is the top pole, 1 the bottom pole, then param1 - 1 rings of param2 vertices
+unsigned int Sphere::vertexAt(int phiIndex, int thetaIndex) {
+    if (phiIndex == 0) {
+        return 0;
+    }
+    if (phiIndex == m_param1) {
+        return 1;
+    }
+    return 2 + (phiIndex - 1) * m_param2 + thetaIndex % m_param2;
+}
+
+void Sphere::makeWedge(int thetaIndex) {
     for (int i = 0; i < m_param1; i++) {
-        float currentPhi = i * M_PI / m_param1;
-        float nextPhi = (i+1) * M_PI / m_param1;
-        glm::vec3 tl = glm::vec3(0.5f * glm::sin(currentPhi) * glm::cos(currentTheta),
-                                 0.5f * glm::cos(currentPhi),
-                                 -0.5f * glm::sin(currentPhi) * glm::sin(currentTheta));
-        glm::vec3 tr = glm::vec3(0.5f * glm::sin(currentPhi) * glm::cos(nextTheta),
-                                 0.5f * glm::cos(currentPhi),
-                                 -0.5f * glm::sin(currentPhi) * glm::sin(nextTheta));
-        glm::vec3 bl = glm::vec3(0.5f * glm::sin(nextPhi) * glm::cos(currentTheta),
-                                 0.5f * glm::cos(nextPhi),
-                                 -0.5f * glm::sin(nextPhi) * glm::sin(currentTheta));
-        glm::vec3 br = glm::vec3(0.5f * glm::sin(nextPhi) * glm::cos(nextTheta),
-                                 0.5f * glm::cos(nextPhi),
-                                 -0.5f * glm::sin(nextPhi) * glm::sin(nextTheta));
-        makeTile(tl, tr, bl, br);
+        unsigned int tl = vertexAt(i, thetaIndex);
+        unsigned int tr = vertexAt(i, thetaIndex + 1);
+        unsigned int bl = vertexAt(i + 1, thetaIndex);
+        unsigned int br = vertexAt(i + 1, thetaIndex + 1);
+
+        // at the poles one triangle of the tile collapses to a line and is left out
+        if (i > 0) {
+            makeTriangle(tl, br, tr);
+        }
+        if (i < m_param1 - 1) {
+            makeTriangle(tl, bl, br);
+        }
     }
 }
 
 void Sphere::makeSphere() {
-    for (int i = 0; i < m_param2; i++) {
-        makeWedge(i * 2*M_PI / m_param2, (i+1) * 2*M_PI / m_param2);
+    makeVertex(glm::vec3(0.f, m_radius, 0.f));
+    makeVertex(glm::vec3(0.f, -m_radius, 0.f));
+    for (int i = 1; i < m_param1; i++) {
+        float phi = i * M_PI / m_param1;
+        for (int j = 0; j < m_param2; j++) {
+            float theta = j * 2*M_PI / m_param2;
+            makeVertex(glm::vec3(m_radius * glm::sin(phi) * glm::cos(theta),
+                                 m_radius * glm::cos(phi),
+                                 -m_radius * glm::sin(phi) * glm::sin(theta)));
+        }
+    }
+
+    for (int j = 0; j < m_param2; j++) {
+        makeWedge(j);
     }
 }
 
 void Sphere::setVertexData() {
+    int vertices = 2 + std::max(m_param1 - 1, 0) * m_param2;
+    int triangles = 2 * m_param2 * std::max(m_param1 - 1, 0);
+    m_vertexData.clear();
+    m_vertexData.reserve(6 * vertices);
+    m_indices.clear();
+    m_indices.reserve(3 * triangles);
+
     makeSphere();
 }
 
+unsigned int Sphere::makeVertex(glm::vec3 position) {
+    unsigned int index = m_vertexData.size() / 6;
+    insertVec3(m_vertexData, position);
+    insertVec3(m_vertexData, glm::normalize(position));
+    return index;
+}
+
+void Sphere::makeTriangle(unsigned int a, unsigned int b, unsigned int c) {
+    m_indices.push_back(a);
+    m_indices.push_back(b);
+    m_indices.push_back(c);
+}
+
 void Sphere::insertVec3(std::vector<float> &data, glm::vec3 v) {
     data.push_back(v.x);
     data.push_back(v.y);
@@ -7,21 +7,22 @@ class Sphere
 {
 public:
     void updateParams(int param1, int param2);
-    std::vector<float> generateShape() { return m_vertexData; }
+    const std::vector<float> &generateShape() { return m_vertexData; }
+    const std::vector<unsigned int> &generateIndices() { return m_indices; }
     int dataLen() { return m_vertexData.size(); }
 
 private:
     void insertVec3(std::vector<float> &data, glm::vec3 v);
+    unsigned int makeVertex(glm::vec3 position);
+    void makeTriangle(unsigned int a, unsigned int b, unsigned int c);
+    unsigned int vertexAt(int phiIndex, int thetaIndex);
     void setVertexData();
-    void makeTile(glm::vec3 topLeft,
-                  glm::vec3 topRight,
-                  glm::vec3 bottomLeft,
-                  glm::vec3 bottomRight);
-    void makeWedge(float currTheta, float nextTheta);
+    void makeWedge(int thetaIndex);
     void makeSphere();
 
-    std::vector<float> m_vertexData;
+    std::vector<float> m_vertexData; //position and normal of every distinct vertex
+    std::vector<unsigned int> m_indices; //three per triangle
     float m_radius = 0.5;
-    int m_param1;
-    int m_param2;
+    int m_param1 = 0;
+    int m_param2 = 0;
 };
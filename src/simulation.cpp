@@ -1,295 +1,882 @@
 #include "src/realtime.h"
 #include "src/settings.h"
 #include "src/joint.h"
+#include "src/springforces.h"
+#include "src/utils/allocationcounter.h"
+#include <QLabel>
+#include <atomic>
+#include <iostream>
+#include <limits>
+
+
+//runs as many fixed steps as the accumulated frame time allows, then blends the
+//last two step states for drawing, so the simulation never sees the raw frame delta
+void Realtime::advanceSimulation(float frameTime) {
+    float stepTime = settings.fixedTimeStep;
+    int substeps = std::max(settings.substeps, 1);
+
+    m_simAccumulator += frameTime;
+    m_frameSolverIterations = 0;
+    m_frameAllocations = 0;
+    int steps = static_cast<int>(m_simAccumulator / stepTime);
+    if (steps > settings.maxCatchUpSteps) {
+        //too far behind, e.g. after a hitch, drop the backlog instead of spiralling
+        steps = settings.maxCatchUpSteps;
+        m_simAccumulator = steps * stepTime;
+    }
 
+    for (int step = 0; step < steps; step++) {
+        if (step == steps - 1) {
+            for (Cloth *cloth : m_cloths) {
+                cloth->m_lastStepPositions = cloth->m_positions;
+            }
+        }
+        for (int sub = 0; sub < substeps; sub++) {
+            simulate(stepTime / substeps);
+            m_frameSolverIterations += m_lastSolverIterations;
+            m_frameAllocations += m_simulateAllocations;
+        }
+    }
+    m_simAccumulator -= steps * stepTime;
+
+    //the report is averaged over about a second and shown in the sidebar, so the loop never prints
+    if (settings.reportSolverIterations) {
+        m_reportIterations += m_frameSolverIterations;
+        m_reportAllocations += m_frameAllocations;
+        m_reportSteps += steps * substeps;
+        m_reportTime += frameTime;
+        if (m_reportTime >= 1.f && m_reportSteps > 0 && m_solverReportLabel) {
+            QString report = QString("Solver iterations: %1 per step, slowest cloth").arg(double(m_reportIterations) / m_reportSteps, 0, 'f', 2);
+            if (m_reportAllocations > 0) {
+                report += QString("\nHeap allocations: %1 per step").arg(double(m_reportAllocations) / m_reportSteps, 0, 'f', 2);
+            }
+            m_solverReportLabel->setText(report);
+            m_reportIterations = 0;
+            m_reportAllocations = 0;
+            m_reportSteps = 0;
+            m_reportTime = 0.f;
+        }
+    }
 
-void Realtime::simulate(float deltaTime) {
-    std::vector<glm::vec3> forces = computeForces(deltaTime);
-    verletIntegration(forces, deltaTime);
+    float alpha = std::clamp(m_simAccumulator / stepTime, 0.f, 1.f);
+    for (Cloth *cloth : m_cloths) {
+        const std::vector<glm::vec3> &from = cloth->m_lastStepPositions;
+        const std::vector<glm::vec3> &to = cloth->m_positions;
+        std::vector<glm::vec3> &out = cloth->m_renderPositions;
+
+        m_threadPool.parallelFor(0, cloth->vertexCount(), settings.parallelGrainSize, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                out[i] = glm::mix(from[i], to[i], alpha);
+            }
+        });
+    }
+}
 
-    for (int i = 0; i < 5; i++) {
-        constrainSprings(1);
-        solveClothToClothCollisions(1, deltaTime);
-        solveCollisions(1, deltaTime);
 
+void Realtime::simulate(float deltaTime) {
+    //the body does not move during a step, every collision pass reads the same table
+    buildColliders();
+
+    //the implicit and projective solvers are built the first time a cloth steps with them, a new timestep,
+    //stiffness or anchor set refactors the projective dynamics matrix; all of it allocates, so it is
+    //settled here rather than in the middle of the step
+    if (settings.solverType == SolverType::implicitEuler) {
+        m_threadPool.parallelFor(0, m_cloths.size(), 1, [&](int begin, int end) {
+            for (int k = begin; k < end; k++) {
+                if (!m_cloths[k]->m_implicitSolver.isBuilt()) {
+                    m_cloths[k]->m_implicitSolver.build(*m_cloths[k]);
+                }
+            }
+        });
+    }
+    else if (settings.solverType == SolverType::projectiveDynamics) {
+        m_threadPool.parallelFor(0, m_cloths.size(), 1, [&](int begin, int end) {
+            for (int k = begin; k < end; k++) {
+                m_cloths[k]->m_projectiveSolver.update(*m_cloths[k], deltaTime, settings.pdStiffnessScale);
+            }
+        });
+    }
+
+    //every buffer the step touches is sized when the cloth is built, debug builds count what the step
+    //allocates anyway, on this thread or on any pool thread working for it
+    size_t allocationsBefore = AllocationCounter::count();
+    AllocationCounter::Guard guard;
+
+    //cloths do not interact, each one is a task on the pool and its own loops nest inside it
+    //the report follows the cloth that needed the most passes, a sum would grow with the cloth count
+    std::atomic<int> iterations{0};
+    m_threadPool.parallelFor(0, m_cloths.size(), 1, [&](int begin, int end) {
+        for (int k = begin; k < end; k++) {
+            int passes = stepCloth(*m_cloths[k], deltaTime);
+            int most = iterations.load();
+            while (passes > most && !iterations.compare_exchange_weak(most, passes)) {
+            }
+        }
+    });
+    m_lastSolverIterations = iterations;
+
+    //the first step that allocates is logged, the solver report keeps counting after that
+    m_simulateAllocations = AllocationCounter::count() - allocationsBefore;
+    if (m_simulateAllocations > 0 && !m_loggedSimulateAllocations) {
+        std::cerr << "Warning: a simulation step allocated on the heap " << m_simulateAllocations << " times" << std::endl;
+        m_loggedSimulateAllocations = true;
     }
 }
 
 
-std::vector<glm::vec3> Realtime::computeForces(float deltaTime) {
+//one step of one cloth, returns the constraint and collision passes it ran
+int Realtime::stepCloth(Cloth &cloth, float deltaTime) {
+    bool xpbd = settings.solverType == SolverType::xpbd;
+    bool projective = settings.solverType == SolverType::projectiveDynamics;
+    int iterations = 0;
 
-    std::vector<glm::vec3> forces(m_cloth->m_vertices.size(), glm::vec3(0.0f));
+    if (settings.clothSleeping) {
+        wakeDisturbedTiles(cloth);
+    }
+    else if (cloth.m_sleepingTileCount > 0) {
+        cloth.wakeAll();
+    }
 
-    //adding gravity
-    for (int i = 0; i < m_cloth->m_vertices.size(); i++) {
-        if (!m_cloth->m_vertices[i].anchored) {
-            forces[i] += settings.gravity;
+    //a cloth that is asleep everywhere stays exactly where it is, there is nothing to solve
+    if (!cloth.allAsleep()) {
+        computeForces(cloth, deltaTime);
+        if (settings.solverType == SolverType::implicitEuler) {
+            implicitEulerIntegration(cloth, cloth.m_forces, deltaTime);
+        }
+        else if (projective) {
+            projectiveIntegration(cloth, cloth.m_forces, deltaTime);
+        }
+        else {
+            verletIntegration(cloth, cloth.m_forces, deltaTime);
         }
-    }
 
-    //adding spring forces, hooks law
-    for (int i = 0; i < m_cloth->m_springs.size(); i++) {
-        Spring* s = &m_cloth->m_springs[i];
+        if (settings.clothSleeping) {
+            wakeStretchedTiles(cloth);
+        }
+
+        if (xpbd) {
+            //multipliers are accumulated over the iterations of one step
+            m_threadPool.parallelFor(0, cloth.m_springs.size(), settings.parallelGrainSize, [&](int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    cloth.m_springs[i].lambda = 0.f;
+                }
+            });
+        }
+
+        bool chebyshev = settings.chebyshevAcceleration;
+        int delay = std::max(settings.chebyshevDelay, 1);
+        float rho2 = settings.chebyshevRho * settings.chebyshevRho;
+        float omega = 1.f;
+
+        //with adaptive iterations the loop stops once the constraints are met, calm steps take only a few passes
+        int maxIterations = settings.solverIterations;
+        int minIterations = settings.adaptiveIterations ? std::clamp(settings.minSolverIterations, 1, std::max(maxIterations, 1)) : maxIterations;
+
+        for (int i = 0; i < maxIterations; i++) {
+            if (chebyshev) {
+                cloth.m_iteratePositions = cloth.m_positions;
+            }
+
+            if (xpbd) {
+                projectSpringsXPBD(cloth, deltaTime);
+            }
+            else if (projective) {
+                projectSpringsPD(cloth);
+            }
+            else {
+                constrainSprings(cloth, 1);
+            }
 
-        glm::vec3* v1_pos = &m_cloth->m_vertices[s->vertexOne].pos;
-        glm::vec3* v2_pos = &m_cloth->m_vertices[s->vertexTwo].pos;
+            if (chebyshev) {
+                //omega_1 = 2 / (2 - rho^2), omega_k+1 = 4 / (4 - rho^2 * omega_k)
+                if (i == delay) {
+                    omega = 2.f / (2.f - rho2);
+                }
+                else if (i > delay) {
+                    omega = 4.f / (4.f - rho2 * omega);
+                }
+                if (i >= delay) {
+                    extrapolateIterate(cloth, omega);
+                }
+                std::swap(cloth.m_iteratePositions, cloth.m_previousIteratePositions);
+            }
 
-        glm::vec3 vector = *v1_pos - *v2_pos; //vector from B(neighbor) to A(current). A = v1, B = v2
-        float magnitude = glm::length(vector);
-        glm::vec3 direction = glm::normalize(vector);
+            solveClothToClothCollisions(cloth, 1, deltaTime);
+            solveCollisions(cloth, 1, deltaTime);
 
+            iterations = i + 1;
+            if (iterations >= minIterations && maxIterations > minIterations
+                && maxConstraintViolation(cloth, deltaTime) < settings.solverTolerance) {
+                break;
+            }
+        }
 
-        glm::vec3 springForce = -s->k * (magnitude - s->rest_length) * direction; //force on A
-        forces[s->vertexOne] += springForce; //A + force
-        forces[s->vertexTwo] -= springForce; // B - force
+        if (settings.clothSleeping) {
+            updateSleeping(cloth, deltaTime);
+        }
     }
 
-    //adding dampening to spring forces
-    for (int i = 0; i < m_cloth->m_springs.size(); i++) {
-        Spring* s = &m_cloth->m_springs[i];
+    return iterations;
+}
 
-        glm::vec3* v1_pos = &m_cloth->m_vertices[s->vertexOne].pos;
-        glm::vec3* v1_prev_pos = &m_cloth->m_vertices[s->vertexOne].prev_pos;
 
-        glm::vec3* v2_pos = &m_cloth->m_vertices[s->vertexTwo].pos;
-        glm::vec3* v2_prev_pos = &m_cloth->m_vertices[s->vertexTwo].prev_pos;
+void Realtime::computeForces(Cloth &cloth, float deltaTime) {
 
-        glm::vec3 v1_velocity = (*v1_pos - *v1_prev_pos) / deltaTime;
-        glm::vec3 v2_velocity = (*v2_pos - *v2_prev_pos) / deltaTime;
+    std::vector<glm::vec3> &forces = cloth.m_forces;
 
-        glm::vec3 vector = *v1_pos - *v2_pos; //vector from B(neighbor) to A(current). A = v1, B = v2
-        float magnitude = glm::length(vector);
-        glm::vec3 direction = glm::normalize(vector);
+    //adding gravity
+    m_threadPool.parallelFor(0, cloth.vertexCount(), settings.parallelGrainSize, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            forces[i] = cloth.isFixed(i) ? glm::vec3(0.0f) : settings.gravity;
+        }
+    });
 
-        glm::vec3 dampeningForce = -s->dampness * glm::dot((v1_velocity - v2_velocity), vector)/magnitude  * direction; //force on A
-        forces[s->vertexOne] += dampeningForce; //A + force
-        forces[s->vertexTwo] -= dampeningForce; // B - force
+    //xpbd and projective dynamics handle springs as constraints, only external forces here
+    if (settings.solverType == SolverType::xpbd || settings.solverType == SolverType::projectiveDynamics) {
+        return;
     }
 
-    return forces;
+    //adding spring forces, hooks law and dampening in one fused pass
+    //stays serial, springs scatter into shared vertices and the AVX2 kernel is bandwidth bound already
+    accumulateSpringForces(cloth, deltaTime, forces.data());
 }
 
 
-void Realtime::verletIntegration(std::vector<glm::vec3> forces, float deltaTime) {
+void Realtime::verletIntegration(Cloth &cloth, const std::vector<glm::vec3> &forces, float deltaTime) {
     //verlet integration
     //x_t+1 = 2*x_t - x_t-1 + (dv/dt)_t * (delta t * delta t)
-    for (int i = 0; i < m_cloth->m_vertices.size(); i++) {
-        Vertex* v = &m_cloth->m_vertices[i];
+    std::vector<glm::vec3> &pos = cloth.m_positions;
+    std::vector<glm::vec3> &prevPos = cloth.m_prevPositions;
+
+    m_threadPool.parallelFor(0, cloth.vertexCount(), settings.parallelGrainSize, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            if (!cloth.isFixed(i)) {
+                glm::vec3 a = (forces[i] + cloth.m_contactForces[i]) * cloth.m_invMasses[i]; //a = F/m
+                glm::vec3 newPos = 2.0f * pos[i] - prevPos[i] + a * deltaTime * deltaTime;
+
+                prevPos[i] = pos[i];
+                pos[i] = newPos;
+            }
+        }
+    });
+}
+
+
+//backward euler, same forces as verletIntegration but the springs are integrated implicitly
+//through a linear solve, so stiff springs stay stable at the fixed timestep
+void Realtime::implicitEulerIntegration(Cloth &cloth, const std::vector<glm::vec3> &forces, float deltaTime) {
+    cloth.m_implicitSolver.step(cloth, forces, deltaTime, settings.cgMaxIterations, settings.cgTolerance);
+}
+
+
+//projective dynamics starts from the inertial prediction, the springs are solved by projectSpringsPD
+void Realtime::projectiveIntegration(Cloth &cloth, const std::vector<glm::vec3> &forces, float deltaTime) {
+    cloth.m_projectiveSolver.predict(cloth, forces, deltaTime);
+}
+
+
+void Realtime::projectSpringsPD(Cloth &cloth) {
+    cloth.m_projectiveSolver.iterate(cloth, m_threadPool, settings.parallelGrainSize);
+}
 
-        if (!v->anchored) {
-            glm::vec3 a = (forces[i] + v->forces) / v->mass; //a = F/m
-            glm::vec3 newPos = 2.0f * v->pos - v->prev_pos + a * deltaTime * deltaTime;
 
-            v->prev_pos = v->pos;
-            v->pos = newPos;
+//largest spring constraint violation relative to the rest length, as the current solver defines the constraint:
+//xpbd measures its compliant constraint C + alpha~ * lambda, the other solvers the 10% stretch limit of constrainSprings
+float Realtime::maxConstraintViolation(Cloth &cloth, float deltaTime) {
+    bool xpbd = settings.solverType == SolverType::xpbd;
+    float invDt2 = 1.f / (deltaTime * deltaTime);
+    std::atomic<float> largest{0.f};
+
+    m_threadPool.parallelFor(0, cloth.m_springs.size(), settings.parallelGrainSize, [&](int begin, int end) {
+        float chunkLargest = 0.f;
+        for (int i = begin; i < end; i++) {
+            const Spring &s = cloth.m_springs[i];
+            float stretch = glm::length(cloth.m_positions[s.vertexOne] - cloth.m_positions[s.vertexTwo]) - s.rest_length;
+
+            float violation = xpbd ? std::abs(stretch + s.compliance * invDt2 * s.lambda)
+                                   : std::max(std::abs(stretch) - 0.1f * s.rest_length, 0.f);
+            chunkLargest = std::max(chunkLargest, violation / s.rest_length);
         }
-    }
+
+        float current = largest.load();
+        while (chunkLargest > current && !largest.compare_exchange_weak(current, chunkLargest)) {
+        }
+    });
+
+    return largest.load();
 }
 
 
-void Realtime::solveCollisions(int iterations, float deltaTime) {
-    for (int i = 0; i < m_cloth->m_vertices.size(); i++) {
-        Vertex* v = &m_cloth->m_vertices[i];
+//chebyshev semi-iterative acceleration (Wang, A Chebyshev Semi-Iterative Approach for Accelerating
+//Projective and Position-based Dynamics): x_k+1 = omega * (x^_k+1 - x_k-1) + x_k-1, where x^_k+1 is the
+//result of the spring pass and x_k-1 the iterate before the current one
+void Realtime::extrapolateIterate(Cloth &cloth, float omega) {
+    std::vector<glm::vec3> &pos = cloth.m_positions;
+    const std::vector<glm::vec3> &previous = cloth.m_previousIteratePositions;
+
+    m_threadPool.parallelFor(0, cloth.vertexCount(), settings.parallelGrainSize, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            if (!cloth.isFixed(i)) {
+                pos[i] = omega * (pos[i] - previous[i]) + previous[i];
+            }
+        }
+    });
+}
+
+
+void Realtime::buildColliders() {
+    //the table is rebuilt in place, joint order is stable so entry k still holds last step's bone k
+    int previousCount = m_colliders.size();
+    int count = 0;
+    m_headTop = glm::vec3(0.f);
+
+    for (Joint *joint : m_joints) {
+        BoneType boneType = joint->getBoneType();
+        glm::vec3 end = joint->getWorldPosition();
 
-        if (v->anchored) {
+        Collider collider;
+        collider.isHead = false;
+
+        if (boneType == SPHERE) {
+            collider.kind = ColliderKind::sphere;
+            collider.isHead = joint->getName() == "head";
+            collider.a = end;
+            collider.b = end;
+            collider.radius = 0.2f;
+        }
+        else if (boneType == CYLINDER) {
+            //the bone runs from the parent joint to this one
+            collider.kind = ColliderKind::capsule;
+            collider.a = joint->getParent()->getWorldPosition();
+            collider.b = end;
+            collider.radius = settings.boneRadius;
+        }
+        else {
             continue;
         }
 
+        bool hasPrevious = count < previousCount && m_colliders[count].kind == collider.kind;
+        collider.prevA = hasPrevious ? m_colliders[count].a : collider.a;
+        collider.prevB = hasPrevious ? m_colliders[count].b : collider.b;
+
+        glm::vec3 reach(collider.radius + settings.clothToShapeCollisionCorrection);
+        collider.boundsMin = glm::min(glm::min(collider.a, collider.b), glm::min(collider.prevA, collider.prevB)) - reach;
+        collider.boundsMax = glm::max(glm::max(collider.a, collider.b), glm::max(collider.prevA, collider.prevB)) + reach;
+
+        if (count < previousCount) {
+            m_colliders[count] = collider;
+        }
         else {
-            glm::vec3 newPos = v->pos;
+            m_colliders.push_back(collider);
+        }
+        count++;
 
-            for (Joint *joint : m_joints) {
+        if (collider.isHead) {
+            m_headTop = 2.f*joint->getWorldPosition() - joint->getParent()->getWorldPosition();
+        }
+    }
 
-                if (joint->getBoneType() == SPHERE) {
+    m_colliders.resize(count);
 
-                    glm::mat4 ctm = joint->getWorldTransform();
+    for (Cloth *cloth : m_cloths) {
+        if (cloth->sphereTop == glm::vec3(0.f)) {
+            cloth->sphereTop = m_headTop;
+        }
+    }
+}
 
-                    glm::vec3 newPosOS = glm::vec3(glm::inverse(ctm) * glm::vec4(newPos, 1.0f));
-                    glm::vec3 sphereCenter = glm::vec4(0,0,0,1.0f);
 
-                    glm::vec3 centerToNewPos = newPosOS - sphereCenter;
-                    float distance = glm::length(centerToNewPos);
-                    float radius = 0.2f;
+//a sleeping tile wakes when a bone that can reach it moves, bones at rest keep supporting the cloth they touch
+void Realtime::wakeDisturbedTiles(Cloth &cloth) {
+    if (cloth.m_sleepingTileCount == 0) {
+        return;
+    }
 
-                    glm::vec3 sphereTop(0.f);
-                    if (joint->getName() == "head") {
-                        sphereTop = 2.f*joint->getWorldPosition() - joint->getParent()->getWorldPosition();
-                        if (m_cloth->sphereTop == glm::vec3(0.f)) {
-                            m_cloth->sphereTop = sphereTop;
-                        }
-                    }
+    for (const Collider &collider : m_colliders) {
+        if (collider.a == collider.prevA && collider.b == collider.prevB) {
+            continue;
+        }
 
-                    //repulsion correction
-                    float epsilon = settings.clothToShapeCollisionCorrection;
+        for (int t = 0; t < cloth.m_tiles.size(); t++) {
+            const ClothTile &tile = cloth.m_tiles[t];
+            if (tile.asleep && !glm::any(glm::lessThan(tile.boundsMax, collider.boundsMin)) && !glm::any(glm::greaterThan(tile.boundsMin, collider.boundsMax))) {
+                cloth.wakeTile(t);
+            }
+        }
+    }
+}
 
-                    //vertex is inside the sphere
-                    if (distance < radius + epsilon) {
 
-                        glm::vec3 normalOS = glm::normalize(centerToNewPos);
+//a sleeping tile also wakes when the awake cloth pulls a spring into it too far, since the awake side cannot drag
+//a frozen vertex along; it runs on the integrated positions, the spring passes would clamp the stretch to 10% first
+void Realtime::wakeStretchedTiles(Cloth &cloth) {
+    if (cloth.m_sleepingTileCount == 0) {
+        return;
+    }
 
-                        //position correction in Object Space
-                        glm::vec3 repelledPosOS = sphereCenter + normalOS * (radius + epsilon);
+    //only springs across the border between sleeping and awake tiles can be stretched
+    for (const Spring &s : cloth.m_springs) {
+        bool oneAsleep = cloth.isSleeping(s.vertexOne);
+        if (oneAsleep == cloth.isSleeping(s.vertexTwo)) {
+            continue;
+        }
 
-                        //position correction in World Space
-                        glm::vec3 repelledPosWS = glm::vec3(ctm * glm::vec4(repelledPosOS, 1.0f));
-                        newPos = repelledPosWS;
+        float distance = glm::length(cloth.m_positions[s.vertexTwo] - cloth.m_positions[s.vertexOne]);
+        if (std::abs(distance - s.rest_length) > settings.wakeStretch * s.rest_length) {
+            cloth.wakeTile(cloth.m_vertexTiles[oneAsleep ? s.vertexOne : s.vertexTwo]);
+        }
+    }
+}
 
-                        glm::vec3 velocity = (repelledPosWS - v->prev_pos) / deltaTime;
 
-                        //friction
-                        glm::vec3 normalWS = glm::transpose(glm::inverse(glm::mat3(ctm))) * normalOS;
-                        normalWS = glm::normalize(normalWS);
-                        glm::vec3 frictionalForce = friction(velocity, normalWS);
-                        v->forces += frictionalForce;
-
-                        if (joint->getName() == "head") {
-                            if (glm::abs(length(repelledPosWS) - length(sphereTop)) < 0.001f) {
-                                v->anchored = true;
-                            }
-                        }
+//a tile's energy is the largest kinetic energy of its free vertices over the step just taken,
+//tiles that stay below settings.sleepEnergy for settings.sleepSteps steps in a row go to sleep
+void Realtime::updateSleeping(Cloth &cloth, float deltaTime) {
+    float invDt2 = 1.f / (deltaTime * deltaTime);
+
+    int grainTiles = std::max(1, settings.parallelGrainSize / (Cloth::tileSize * Cloth::tileSize));
+    m_threadPool.parallelFor(0, cloth.m_tiles.size(), grainTiles, [&](int begin, int end) {
+        for (int t = begin; t < end; t++) {
+            ClothTile &tile = cloth.m_tiles[t];
+            if (tile.asleep) {
+                continue;
+            }
+
+            float energy = 0.f;
+            for (int gi = tile.iBegin; gi < tile.iEnd; gi++) {
+                for (int gj = tile.jBegin; gj < tile.jEnd; gj++) {
+                    int i = cloth.gridIndex(gi, gj);
+                    if (cloth.isAnchored(i)) {
+                        continue;
                     }
 
-                    v->pos = newPos;
+                    glm::vec3 moved = cloth.m_positions[i] - cloth.m_prevPositions[i];
+                    energy = std::max(energy, 0.5f / cloth.m_invMasses[i] * glm::dot(moved, moved) * invDt2); //1/2 m v^2
                 }
+            }
 
-                if (joint->getBoneType() == CYLINDER) {
+            tile.quietSteps = energy < settings.sleepEnergy ? tile.quietSteps + 1 : 0;
+        }
+    });
 
-                    glm::mat4 ctm = joint->getWorldTransform();
-                    glm::vec3 newPosOS = glm::vec3(glm::inverse(ctm) * glm::vec4(newPos, 1.0f));
-                    float radius = 0.3f;
-                    // float halfHeight = 0.5f;
+    for (int t = 0; t < cloth.m_tiles.size(); t++) {
+        if (!cloth.m_tiles[t].asleep && cloth.m_tiles[t].quietSteps >= settings.sleepSteps) {
+            cloth.sleepTile(t);
+        }
+    }
+}
 
-                    float halfHeight = glm::length(joint->getBoneVec()) / 2.0f;
 
-                    float epsilon = settings.clothToShapeCollisionCorrection;
+void Realtime::solveCollisions(Cloth &cloth, int iterations, float deltaTime) {
+    //repulsion correction
+    float epsilon = settings.clothToShapeCollisionCorrection;
 
-                    //distance from axis
-                    float distance = glm::length(glm::vec2(newPosOS.x, newPosOS.z));
+    bool continuous = settings.continuousCollisions;
 
-                    glm::vec3 cylinderCenter = glm::vec4(0,0,0,1.0f);
+    //broadphase: a tile only runs the narrow phase against colliders whose box overlaps the tile box
+    //each vertex still meets the colliders in table order, so culling does not change the result
+    int grainTiles = std::max(1, settings.parallelGrainSize / (Cloth::tileSize * Cloth::tileSize));
+    m_threadPool.parallelFor(0, cloth.m_tiles.size(), grainTiles, [&](int begin, int end) {
+        for (int t = begin; t < end; t++) {
+            const ClothTile &tile = cloth.m_tiles[t];
+            if (tile.asleep) {
+                continue;
+            }
 
-                    //vertex is inside cylinder
-                    if (distance < radius + epsilon && newPosOS.y > -halfHeight - epsilon && newPosOS.y < halfHeight + epsilon) {
+            glm::vec3 tileMin(std::numeric_limits<float>::max());
+            glm::vec3 tileMax(-std::numeric_limits<float>::max());
+            for (int gi = tile.iBegin; gi < tile.iEnd; gi++) {
+                for (int gj = tile.jBegin; gj < tile.jEnd; gj++) {
+                    int i = cloth.gridIndex(gi, gj);
+                    tileMin = glm::min(tileMin, cloth.m_positions[i]);
+                    tileMax = glm::max(tileMax, cloth.m_positions[i]);
+
+                    //swept tests cover the whole path since the last step
+                    if (continuous) {
+                        tileMin = glm::min(tileMin, cloth.m_prevPositions[i]);
+                        tileMax = glm::max(tileMax, cloth.m_prevPositions[i]);
+                    }
+                }
+            }
 
-                        glm::vec3 normalOS(0.f);
-                        glm::vec3 repelledPosOS = newPosOS;
+            for (const Collider &collider : m_colliders) {
+                if (glm::any(glm::lessThan(tileMax, collider.boundsMin)) || glm::any(glm::greaterThan(tileMin, collider.boundsMax))) {
+                    continue;
+                }
 
-                        // Distances to boundaries
-                        float distanceToSide = radius - distance;
-                        float distanceToTop  = halfHeight - newPosOS.y;
-                        float distanceToBottom  = newPosOS.y + halfHeight;
+                float surface = collider.radius + epsilon;
 
-                        //find closest boundary
-                        if (distanceToSide <= distanceToTop && distanceToSide <= distanceToBottom) {
-                            //sides of cylinder
-                            glm::vec2 direction = glm::normalize(glm::vec2(newPosOS.x, newPosOS.z));
-                            normalOS = glm::vec3(direction.x, 0.f, direction.y);
-                            repelledPosOS.x = direction.x * (radius + epsilon);
-                            repelledPosOS.z = direction.y * (radius + epsilon);
+                for (int gi = tile.iBegin; gi < tile.iEnd; gi++) {
+                    for (int gj = tile.jBegin; gj < tile.jEnd; gj++) {
+                        int i = cloth.gridIndex(gi, gj);
+                        if (cloth.isAnchored(i)) {
+                            continue;
                         }
-                        else if (distanceToTop <= distanceToBottom) {
-                            //top cap
-                            normalOS = glm::vec3(0, 1, 0);
-                            repelledPosOS.y = halfHeight + epsilon;
 
+                        glm::vec3 &pos = cloth.m_positions[i];
+                        glm::vec3 closest = collider.closestPoint(pos);
+                        glm::vec3 offset = pos - closest;
+                        float distance2 = glm::dot(offset, offset);
+
+                        glm::vec3 normal;
+                        glm::vec3 repelledPos;
+
+                        if (distance2 < surface * surface) {
+                            //push out along the normal by the penetration depth, surface - distance
+                            float distance = std::sqrt(distance2);
+                            normal = distance > 1e-6f ? offset / distance : glm::vec3(0.f, 1.f, 0.f);
+                            repelledPos = closest + normal * surface;
                         }
-                        else {
-                            //bottom cap
-                            normalOS = glm::vec3(0, -1, 0);
-                            repelledPosOS.y = -halfHeight - epsilon;
+                        else if (!continuous || !collider.tunneled(cloth.m_prevPositions[i], pos, surface, repelledPos, normal)) {
+                            //vertex is outside the collider and did not pass through it
+                            continue;
                         }
 
-                        //position correction in World Space
-                        glm::vec3 repelledPosWS = glm::vec3(ctm * glm::vec4(repelledPosOS, 1.0f));
-                        newPos = repelledPosWS;
+                        pos = repelledPos;
+
+                        //the tile box has to keep covering its vertices for the colliders after this one
+                        tileMin = glm::min(tileMin, pos);
+                        tileMax = glm::max(tileMax, pos);
 
-                        glm::vec3 velocity = (repelledPosWS - v->prev_pos) / deltaTime;
+                        glm::vec3 velocity = (repelledPos - cloth.m_prevPositions[i]) / deltaTime;
 
                         //friction
-                        glm::vec3 normalWS = glm::transpose(glm::inverse(glm::mat3(ctm))) * normalOS;
-                        normalWS = glm::normalize(normalWS);
-                        glm::vec3 frictionalForce = friction(velocity, normalWS);
-                        v->forces += frictionalForce;
+                        glm::vec3 frictionalForce = friction(velocity, normal);
+                        cloth.m_contactForces[i] += frictionalForce;
+
+                        if (collider.isHead) {
+                            if (glm::abs(length(repelledPos) - length(m_headTop)) < 0.001f) {
+                                cloth.setAnchored(i);
+                            }
+                        }
                     }
+                }
+            }
+        }
+    });
+}
+
+
+void Realtime::solveClothToClothCollisions(Cloth &cloth, int iterations, float deltaTime) {
+    if (settings.triangleSelfCollision) {
+        solveTriangleSelfCollisions(cloth);
+        return;
+    }
+
+    std::vector<glm::vec3> &pos = cloth.m_positions;
+    float minDistance = 2*settings.clothVertexRadius;
+
+    //pushes two overlapping vertices apart along the line between them
+    auto resolvePair = [&](int i, int j) {
+        float distance = glm::length(pos[j] - pos[i]); //distance between vertices
+
+        if (distance < minDistance) {
+            //sleeping vertices stay put, the awake one takes the whole correction
+            float wi = cloth.isSleeping(i) ? 0.f : 1.f;
+            float wj = cloth.isSleeping(j) ? 0.f : 1.f;
+            if (wi + wj == 0.f) {
+                return;
+            }
+
+            glm::vec3 direction = glm::normalize(pos[j] - pos[i]); //direction from i to j
+            float overlap = minDistance - distance;
+            float correction = (overlap + settings.clothToClothCollisionCorrection) / (wi + wj);
+            pos[i] -= wi * correction * direction;
+            pos[j] += wj * correction * direction;
+        }
+    };
 
-                    v->pos = newPos;
+    if (!settings.useSpatialHash) {
+        //brute force reference, every pair of vertices once like the hash visits them
+        for (int i = 0; i < cloth.vertexCount(); i++) {
+            for (int j = i + 1; j < cloth.vertexCount(); j++) {
 
+                if (cloth.hasNeighbor(i, j)) { //connected by a spring
+                    continue;
                 }
 
+                resolvePair(i, j);
             }
         }
+        return;
+    }
+
+    //grid is rebuilt every solver iteration, cells are one contact distance wide
+    SpatialHash &hash = cloth.m_selfCollisionHash;
+    hash.build(pos, minDistance);
+
+    for (int i = 0; i < cloth.vertexCount(); i++) {
+        hash.forEachCandidate(i, pos[i], [&](int j) {
+            if (cloth.areConnected(i, j)) {
+                return;
+            }
+
+            resolvePair(i, j);
+        });
     }
 }
 
 
-void::Realtime::solveClothToClothCollisions(int iterations, float deltaTime) {
-    for (int i = 0; i < m_cloth->m_vertices.size(); i++) {
+void Realtime::constrainSprings(Cloth &cloth, int iterations) {
+    //springs of one color never share a vertex, so a color can be split across threads freely
+    //colors run in a fixed order, which keeps the result the same for any thread count
+    for (int c = 0; c < Cloth::springColorCount; c++) {
+        m_threadPool.parallelFor(cloth.m_springColorOffsets[c], cloth.m_springColorOffsets[c + 1], settings.parallelGrainSize, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                const Spring &s = cloth.m_springs[i];
 
-        Vertex* v1 = &m_cloth->m_vertices[i];
+                glm::vec3 &v1 = cloth.m_positions[s.vertexOne];
+                glm::vec3 &v2 = cloth.m_positions[s.vertexTwo];
+                bool v1Anchored = cloth.isFixed(s.vertexOne);
+                bool v2Anchored = cloth.isFixed(s.vertexTwo);
 
-        for (int j = 0; j < m_cloth->m_vertices.size(); j++) {
+                float distance = glm::length(v2 - v1); //distance between vertices
+                glm::vec3 direction = glm::normalize(v2 - v1); //direction from v1 to v2
 
-            if (i == j) { //same vertex
-                continue;
-            }
+                if (distance < 1e-6f) { //no distance between the two vertices (spring length effectively 0)
+                    continue;
+                }
+
+                float stretch = distance - s.rest_length;
+                float maxStretch = s.rest_length * 0.1f; //spring can stretch 10%
+
+                //stretch correction
+                if (fabs(stretch) > maxStretch) {
+                    float stretchCorrection = stretch - (stretch > 0 ? maxStretch : -maxStretch);
 
-            bool isNeighbor = false;
-            for (int n : v1->neighbors) {
-                if (n == j) { //m_vertices[j] is a neighbor of m_vertices[i]
-                    isNeighbor = true;
-                    break;
+                    if (!v1Anchored && !v2Anchored) {
+                        v1 += 0.5f * direction * stretchCorrection;
+                        v2 -= 0.5f * direction * stretchCorrection;
+                    }
+                    else if (!v1Anchored) {
+                        v1 += direction * stretchCorrection;
+                    }
+                    else if (!v2Anchored) {
+                        v2 -= direction * stretchCorrection;
+                    }
                 }
             }
+        });
+    }
+}
 
-            if (isNeighbor) {
-                continue;
-            }
 
-            Vertex* v2 = &m_cloth->m_vertices[j];
-            float distance = glm::length(v2->pos - v1->pos); //distance between vertices
+//xpbd distance constraints C = |x1 - x2| - rest, with compliance alpha = 1/k
+//  dLambda = (-C - alpha~ * lambda - gamma * dot(n, v1 - v2) * dt) / ((1 + gamma) * (w1 + w2) + alpha~)
+//alpha~ = alpha / dt^2 and gamma = alpha * dampness / dt is the matching constraint damping
+//colors are projected in parallel the same way as constrainSprings
+void Realtime::projectSpringsXPBD(Cloth &cloth, float deltaTime) {
+    float invDt2 = 1.f / (deltaTime * deltaTime);
 
-            if (distance < 2*settings.clothVertexRadius) {
-                glm::vec3 direction = glm::normalize(v2->pos - v1->pos); //direction from v1 to v2
-                float overlap = 2*settings.clothVertexRadius - distance;
-                v1->pos -= 0.5f * (overlap + settings.clothToClothCollisionCorrection) * direction;
-                v2->pos += 0.5f * (overlap + settings.clothToClothCollisionCorrection) * direction;
+    for (int c = 0; c < Cloth::springColorCount; c++) {
+        m_threadPool.parallelFor(cloth.m_springColorOffsets[c], cloth.m_springColorOffsets[c + 1], settings.parallelGrainSize, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                Spring &s = cloth.m_springs[i];
+
+                glm::vec3 &v1 = cloth.m_positions[s.vertexOne];
+                glm::vec3 &v2 = cloth.m_positions[s.vertexTwo];
+                float w1 = cloth.isFixed(s.vertexOne) ? 0.f : cloth.m_invMasses[s.vertexOne];
+                float w2 = cloth.isFixed(s.vertexTwo) ? 0.f : cloth.m_invMasses[s.vertexTwo];
+
+                glm::vec3 d = v1 - v2;
+                float distance = glm::length(d);
+                if (w1 + w2 == 0.f || distance < 1e-6f) {
+                    continue;
+                }
+                glm::vec3 n = d / distance;
+
+                float alphaTilde = s.compliance * invDt2;
+                float gamma = s.compliance * s.dampness / deltaTime;
+
+                //relative displacement this step, velocity * dt
+                glm::vec3 moved = (v1 - cloth.m_prevPositions[s.vertexOne]) - (v2 - cloth.m_prevPositions[s.vertexTwo]);
+
+                float constraint = distance - s.rest_length;
+                float dLambda = (-constraint - alphaTilde * s.lambda - gamma * glm::dot(n, moved))
+                                / ((1.f + gamma) * (w1 + w2) + alphaTilde);
+
+                s.lambda += dLambda;
+                v1 += w1 * dLambda * n;
+                v2 -= w2 * dLambda * n;
             }
-        }
+        });
     }
 }
 
 
-void Realtime::constrainSprings(int iterations) {
-    for (Spring& s : m_cloth->m_springs) {
+//barycentric weights of the point on triangle abc closest to p (Ericson, Real-Time Collision Detection 5.1.5)
+static glm::vec3 closestTriangleWeights(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c) {
+    glm::vec3 ab = b - a;
+    glm::vec3 ac = c - a;
+    glm::vec3 ap = p - a;
+    float d1 = glm::dot(ab, ap);
+    float d2 = glm::dot(ac, ap);
+    if (d1 <= 0.f && d2 <= 0.f) return glm::vec3(1.f, 0.f, 0.f);
+
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp);
+    float d4 = glm::dot(ac, bp);
+    if (d3 >= 0.f && d4 <= d3) return glm::vec3(0.f, 1.f, 0.f);
+
+    float vc = d1*d4 - d3*d2;
+    if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+        float v = d1 / (d1 - d3);
+        return glm::vec3(1.f - v, v, 0.f);
+    }
+
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp);
+    float d6 = glm::dot(ac, cp);
+    if (d6 >= 0.f && d5 <= d6) return glm::vec3(0.f, 0.f, 1.f);
 
-        Vertex* v1 = &m_cloth->m_vertices[s.vertexOne];
-        Vertex* v2 = &m_cloth->m_vertices[s.vertexTwo];
+    float vb = d5*d2 - d1*d6;
+    if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+        float w = d2 / (d2 - d6);
+        return glm::vec3(1.f - w, 0.f, w);
+    }
 
-        float distance = glm::length(v2->pos - v1->pos); //distance between vertices
-        glm::vec3 direction = glm::normalize(v2->pos - v1->pos); //direction from v1 to v2
+    float va = d3*d6 - d5*d4;
+    if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f) {
+        float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        return glm::vec3(0.f, 1.f - w, w);
+    }
+
+    float denom = 1.f / (va + vb + vc);
+    float v = vb * denom;
+    float w = vc * denom;
+    return glm::vec3(1.f - v - w, v, w);
+}
 
-        if (distance < 1e-6f) { //no distance between the two vertices (spring length effectively 0)
-            continue;
-        }
 
-        float stretch = distance - s.rest_length;
-        float maxStretch = s.rest_length * 0.1f; //spring can stretch 10%
+//parameters s, t of the closest points p1 + s(q1 - p1) and p2 + t(q2 - p2) of two segments (Ericson 5.1.9)
+static glm::vec2 closestSegmentParams(const glm::vec3 &p1, const glm::vec3 &q1, const glm::vec3 &p2, const glm::vec3 &q2) {
+    glm::vec3 d1 = q1 - p1;
+    glm::vec3 d2 = q2 - p2;
+    glm::vec3 r = p1 - p2;
+    float a = glm::dot(d1, d1);
+    float e = glm::dot(d2, d2);
+    float f = glm::dot(d2, r);
+    float c = glm::dot(d1, r);
+    float b = glm::dot(d1, d2);
+    float denom = a*e - b*b;
+
+    if (e < 1e-12f) { //second segment is a point
+        return glm::vec2(a < 1e-12f ? 0.f : glm::clamp(-c / a, 0.f, 1.f), 0.f);
+    }
+
+    float s = denom > 1e-12f ? glm::clamp((b*f - c*e) / denom, 0.f, 1.f) : 0.f; //parallel, any s works
+    float t = (b*s + f) / e;
+
+    if (t < 0.f) {
+        t = 0.f;
+        s = glm::clamp(-c / a, 0.f, 1.f);
+    }
+    else if (t > 1.f) {
+        t = 1.f;
+        s = glm::clamp((b - c) / a, 0.f, 1.f);
+    }
+    return glm::vec2(s, t);
+}
 
-        //stretch correction
-        if (fabs(stretch) > maxStretch) {
-            float stretchCorrection = stretch - (stretch > 0 ? maxStretch : -maxStretch);
 
-            if (!v1->anchored && !v2->anchored) {
-                v1->pos += 0.5f * direction * stretchCorrection;
-                v2->pos -= 0.5f * direction * stretchCorrection;
+//keeps unconnected parts of the cloth at least clothThickness apart
+//vertex against triangle and edge against edge, pushed apart along the contact normal with
+//each vertex moving in proportion to its weight in the contact point, anchored vertices do not move
+void Realtime::solveTriangleSelfCollisions(Cloth &cloth) {
+    std::vector<glm::vec3> &pos = cloth.m_positions;
+    const std::vector<GLuint> &tri = cloth.m_triangleIndices;
+    float thickness = settings.clothThickness;
+    glm::vec3 reach(thickness);
+
+    //refit, not rebuild, the topology never changes and the cloth moves little per pass
+    cloth.m_triangleBVH.refit(pos, 0.f);
+
+    auto mobility = [&](int v) { return cloth.isFixed(v) ? 0.f : 1.f; };
+
+    //vertex against triangle
+    for (int i = 0; i < cloth.vertexCount(); i++) {
+        cloth.m_triangleBVH.forEachTriangle(pos[i] - reach, pos[i] + reach, [&](int t) {
+            int v[3] = {(int)tri[3*t], (int)tri[3*t + 1], (int)tri[3*t + 2]};
+            if (v[0] == i || v[1] == i || v[2] == i) {
+                return;
             }
-            else if (!v1->anchored) {
-                v1->pos += direction * stretchCorrection;
+
+            glm::vec3 w = closestTriangleWeights(pos[i], pos[v[0]], pos[v[1]], pos[v[2]]);
+            glm::vec3 closest = w.x * pos[v[0]] + w.y * pos[v[1]] + w.z * pos[v[2]];
+            glm::vec3 offset = pos[i] - closest;
+            float distance = glm::length(offset);
+            if (distance >= thickness || distance < 1e-7f) {
+                return;
             }
-            else if (!v2->anchored) {
-                v2->pos -= direction * stretchCorrection;
+
+            //triangles around the vertex are close by construction, not a contact
+            if (cloth.areConnected(i, v[0]) || cloth.areConnected(i, v[1]) || cloth.areConnected(i, v[2])) {
+                return;
             }
-        }
+
+            float weightSum = mobility(i) + w.x*w.x*mobility(v[0]) + w.y*w.y*mobility(v[1]) + w.z*w.z*mobility(v[2]);
+            if (weightSum == 0.f) {
+                return;
+            }
+
+            glm::vec3 push = (thickness - distance) / weightSum * (offset / distance);
+            pos[i] += mobility(i) * push;
+            for (int k = 0; k < 3; k++) {
+                pos[v[k]] -= w[k] * mobility(v[k]) * push;
+            }
+        });
+    }
+
+    //edge against edge, each pair once: the second edge must have the larger index
+    std::fill(cloth.m_edgeVisit.begin(), cloth.m_edgeVisit.end(), -1);
+    for (int e = 0; e < cloth.m_edges.size(); e++) {
+        int p1 = cloth.m_edges[e].x;
+        int q1 = cloth.m_edges[e].y;
+
+        cloth.m_triangleBVH.forEachTriangle(glm::min(pos[p1], pos[q1]) - reach, glm::max(pos[p1], pos[q1]) + reach, [&](int t) {
+            for (int k = 0; k < 3; k++) {
+                int f = cloth.m_triangleEdges[3*t + k];
+                if (f <= e || cloth.m_edgeVisit[f] == e) {
+                    continue;
+                }
+                cloth.m_edgeVisit[f] = e; //edges are shared by two triangles
+
+                int p2 = cloth.m_edges[f].x;
+                int q2 = cloth.m_edges[f].y;
+                if (p1 == p2 || p1 == q2 || q1 == p2 || q1 == q2) {
+                    continue;
+                }
+
+                glm::vec2 st = closestSegmentParams(pos[p1], pos[q1], pos[p2], pos[q2]);
+                glm::vec3 c1 = glm::mix(pos[p1], pos[q1], st.x);
+                glm::vec3 c2 = glm::mix(pos[p2], pos[q2], st.y);
+                glm::vec3 offset = c1 - c2;
+                float distance = glm::length(offset);
+                if (distance >= thickness || distance < 1e-7f) {
+                    continue;
+                }
+
+                //neighboring edges are close by construction, not a contact
+                if (cloth.areConnected(p1, p2) || cloth.areConnected(p1, q2) || cloth.areConnected(q1, p2) || cloth.areConnected(q1, q2)) {
+                    continue;
+                }
+
+                float w[4] = {1.f - st.x, st.x, 1.f - st.y, st.y};
+                int v[4] = {p1, q1, p2, q2};
+                float weightSum = 0.f;
+                for (int m = 0; m < 4; m++) {
+                    weightSum += w[m] * w[m] * mobility(v[m]);
+                }
+                if (weightSum == 0.f) {
+                    continue;
+                }
+
+                glm::vec3 push = (thickness - distance) / weightSum * (offset / distance);
+                for (int m = 0; m < 4; m++) {
+                    pos[v[m]] += (m < 2 ? w[m] : -w[m]) * mobility(v[m]) * push;
+                }
+            }
+        });
     }
 }
 
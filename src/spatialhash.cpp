@@ -0,0 +1,51 @@
+#include "spatialhash.h"
+
+
+//power of two table with roughly two buckets per vertex
+int SpatialHash::tableSizeFor(int n) {
+    int tableSize = 1;
+    while (tableSize < 2 * n) {
+        tableSize <<= 1;
+    }
+    return tableSize;
+}
+
+
+void SpatialHash::reserve(int n) {
+    m_bucketStart.reserve(tableSizeFor(n) + 1);
+    m_entries.reserve(n);
+    m_vertexBucket.reserve(n);
+}
+
+
+void SpatialHash::build(const std::vector<glm::vec3> &positions, float cellSize) {
+    int n = positions.size();
+    m_invCellSize = 1.f / cellSize;
+
+    int tableSize = tableSizeFor(n);
+    m_tableMask = tableSize - 1;
+
+    //buffers only grow, so rebuilding every iteration does not reallocate
+    m_bucketStart.assign(tableSize + 1, 0);
+    m_entries.resize(n);
+    m_vertexBucket.resize(n);
+
+    //counting sort of vertices into buckets
+    for (int i = 0; i < n; i++) {
+        int bucket = hashCell(cellOf(positions[i]));
+        m_vertexBucket[i] = bucket;
+        m_bucketStart[bucket]++;
+    }
+
+    //inclusive prefix sum, m_bucketStart[b] is now the end of bucket b
+    for (int b = 1; b < tableSize; b++) {
+        m_bucketStart[b] += m_bucketStart[b - 1];
+    }
+    m_bucketStart[tableSize] = n;
+
+    //fill back to front so each end moves to its bucket's start and buckets stay in ascending vertex order
+    for (int i = n - 1; i >= 0; i--) {
+        int bucket = m_vertexBucket[i];
+        m_entries[--m_bucketStart[bucket]] = i;
+    }
+}
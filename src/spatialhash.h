@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// uniform hash grid used as the broadphase for cloth to cloth collisions
+// cells are cellSize wide, so any pair closer than cellSize lies in neighboring cells
+class SpatialHash
+{
+public:
+    //sizes every buffer for n vertices so later builds do not allocate
+    void reserve(int n);
+    void build(const std::vector<glm::vec3> &positions, float cellSize);
+
+    //calls f(j) for every vertex j > i stored in the 27 cells around p
+    template <typename F>
+    void forEachCandidate(int i, const glm::vec3 &p, F &&f) const;
+
+private:
+    static int tableSizeFor(int n);
+    glm::ivec3 cellOf(const glm::vec3 &p) const;
+    int hashCell(const glm::ivec3 &cell) const;
+
+    float m_invCellSize = 1.f;
+    int m_tableMask = 0;
+    std::vector<int> m_bucketStart;   //prefix sums, bucket b holds m_entries[m_bucketStart[b], m_bucketStart[b+1])
+    std::vector<int> m_entries;       //vertex indices sorted by bucket
+    std::vector<int> m_vertexBucket;  //bucket of each vertex at build time
+};
+
+
+inline glm::ivec3 SpatialHash::cellOf(const glm::vec3 &p) const {
+    return glm::ivec3(glm::floor(p * m_invCellSize));
+}
+
+inline int SpatialHash::hashCell(const glm::ivec3 &cell) const {
+    unsigned int h = (unsigned int)(cell.x) * 73856093u ^ (unsigned int)(cell.y) * 19349663u ^ (unsigned int)(cell.z) * 83492791u;
+    return h & m_tableMask;
+}
+
+template <typename F>
+void SpatialHash::forEachCandidate(int i, const glm::vec3 &p, F &&f) const {
+    glm::ivec3 center = cellOf(p);
+
+    //different cells can share a bucket, only visit each bucket once
+    int visited[27];
+    int visitedCount = 0;
+
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dz = -1; dz <= 1; dz++) {
+                int bucket = hashCell(center + glm::ivec3(dx, dy, dz));
+
+                bool seen = false;
+                for (int k = 0; k < visitedCount; k++) {
+                    if (visited[k] == bucket) {
+                        seen = true;
+                        break;
+                    }
+                }
+                if (seen) {
+                    continue;
+                }
+                visited[visitedCount++] = bucket;
+
+                for (int e = m_bucketStart[bucket]; e < m_bucketStart[bucket + 1]; e++) {
+                    int j = m_entries[e];
+                    if (j > i) { //each unordered pair is handled once
+                        f(j);
+                    }
+                }
+            }
+        }
+    }
+}
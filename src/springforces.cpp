@@ -0,0 +1,186 @@
+#include "springforces.h"
+#include <cmath>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define SPRING_FORCES_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(SPRING_FORCES_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SPRING_FORCES_AVX2 __attribute__((target("avx2")))
+#else
+#define SPRING_FORCES_AVX2
+#endif
+
+
+//springs [begin, end), shared by the scalar kernel and the AVX2 tail
+static void springForceRange(const Cloth &cloth, float deltaTime, glm::vec3 *forces, int begin, int end) {
+    const glm::vec3 *pos = cloth.m_positions.data();
+    const glm::vec3 *prevPos = cloth.m_prevPositions.data();
+
+    for (int i = begin; i < end; i++) {
+        const Spring &s = cloth.m_springs[i];
+
+        glm::vec3 p1 = pos[s.vertexOne];
+        glm::vec3 p2 = pos[s.vertexTwo];
+        glm::vec3 q1 = prevPos[s.vertexOne];
+        glm::vec3 q2 = prevPos[s.vertexTwo];
+
+        //vector from B(vertexTwo) to A(vertexOne) and relative velocity of A
+        float dx = p1.x - p2.x;
+        float dy = p1.y - p2.y;
+        float dz = p1.z - p2.z;
+        float vx = (p1.x - q1.x) / deltaTime - (p2.x - q2.x) / deltaTime;
+        float vy = (p1.y - q1.y) / deltaTime - (p2.y - q2.y) / deltaTime;
+        float vz = (p1.z - q1.z) / deltaTime - (p2.z - q2.z) / deltaTime;
+
+        float len2 = dx*dx + dy*dy + dz*dz;
+        float invLen = 1.f / std::sqrt(len2);
+        float len = len2 * invLen;
+
+        float stretch = s.k * (len - s.rest_length);
+        float damping = s.dampness * (vx*dx + vy*dy + vz*dz) * invLen;
+        float coef = -(stretch + damping) * invLen;
+
+        glm::vec3 force(coef * dx, coef * dy, coef * dz); //force on A
+        forces[s.vertexOne] += force;
+        forces[s.vertexTwo] -= force;
+    }
+}
+
+
+void accumulateSpringForcesScalar(const Cloth &cloth, float deltaTime, glm::vec3 *forces) {
+    springForceRange(cloth, deltaTime, forces, 0, cloth.m_springs.size());
+}
+
+
+#ifdef SPRING_FORCES_X86
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "positions are gathered as packed floats");
+static_assert(sizeof(Spring) % sizeof(float) == 0, "springs are gathered in float sized strides");
+
+//8 springs per iteration, forces are scattered back in spring order so the sums match the scalar kernel
+SPRING_FORCES_AVX2
+static void accumulateSpringForcesAVX2(const Cloth &cloth, float deltaTime, glm::vec3 *forces) {
+    const float *pos = reinterpret_cast<const float*>(cloth.m_positions.data());
+    const float *prevPos = reinterpret_cast<const float*>(cloth.m_prevPositions.data());
+    const int *springInts = reinterpret_cast<const int*>(cloth.m_springs.data());
+    const float *springFloats = reinterpret_cast<const float*>(cloth.m_springs.data());
+
+    const int stride = sizeof(Spring) / sizeof(float);
+    const int oneOffset = offsetof(Spring, vertexOne) / sizeof(float);
+    const int twoOffset = offsetof(Spring, vertexTwo) / sizeof(float);
+    const int kOffset = offsetof(Spring, k) / sizeof(float);
+    const int dampOffset = offsetof(Spring, dampness) / sizeof(float);
+    const int restOffset = offsetof(Spring, rest_length) / sizeof(float);
+
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i springStride = _mm256_set1_epi32(stride);
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256 dt = _mm256_set1_ps(deltaTime);
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 zero = _mm256_setzero_ps();
+
+    alignas(32) int one_idx[8], two_idx[8];
+    alignas(32) float fx[8], fy[8], fz[8];
+
+    int count = cloth.m_springs.size();
+    int vectorEnd = count - count % 8;
+
+    for (int base = 0; base < vectorEnd; base += 8) {
+        __m256i springIdx = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_set1_epi32(base), lane), springStride);
+
+        __m256i a = _mm256_i32gather_epi32(springInts + oneOffset, springIdx, 4);
+        __m256i b = _mm256_i32gather_epi32(springInts + twoOffset, springIdx, 4);
+        __m256 k = _mm256_i32gather_ps(springFloats + kOffset, springIdx, 4);
+        __m256 dampness = _mm256_i32gather_ps(springFloats + dampOffset, springIdx, 4);
+        __m256 rest = _mm256_i32gather_ps(springFloats + restOffset, springIdx, 4);
+
+        __m256i a3 = _mm256_mullo_epi32(a, three);
+        __m256i b3 = _mm256_mullo_epi32(b, three);
+
+        __m256 p1x = _mm256_i32gather_ps(pos + 0, a3, 4);
+        __m256 p1y = _mm256_i32gather_ps(pos + 1, a3, 4);
+        __m256 p1z = _mm256_i32gather_ps(pos + 2, a3, 4);
+        __m256 p2x = _mm256_i32gather_ps(pos + 0, b3, 4);
+        __m256 p2y = _mm256_i32gather_ps(pos + 1, b3, 4);
+        __m256 p2z = _mm256_i32gather_ps(pos + 2, b3, 4);
+        __m256 q1x = _mm256_i32gather_ps(prevPos + 0, a3, 4);
+        __m256 q1y = _mm256_i32gather_ps(prevPos + 1, a3, 4);
+        __m256 q1z = _mm256_i32gather_ps(prevPos + 2, a3, 4);
+        __m256 q2x = _mm256_i32gather_ps(prevPos + 0, b3, 4);
+        __m256 q2y = _mm256_i32gather_ps(prevPos + 1, b3, 4);
+        __m256 q2z = _mm256_i32gather_ps(prevPos + 2, b3, 4);
+
+        __m256 dx = _mm256_sub_ps(p1x, p2x);
+        __m256 dy = _mm256_sub_ps(p1y, p2y);
+        __m256 dz = _mm256_sub_ps(p1z, p2z);
+        __m256 vx = _mm256_sub_ps(_mm256_div_ps(_mm256_sub_ps(p1x, q1x), dt), _mm256_div_ps(_mm256_sub_ps(p2x, q2x), dt));
+        __m256 vy = _mm256_sub_ps(_mm256_div_ps(_mm256_sub_ps(p1y, q1y), dt), _mm256_div_ps(_mm256_sub_ps(p2y, q2y), dt));
+        __m256 vz = _mm256_sub_ps(_mm256_div_ps(_mm256_sub_ps(p1z, q1z), dt), _mm256_div_ps(_mm256_sub_ps(p2z, q2z), dt));
+
+        __m256 len2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+        __m256 invLen = _mm256_div_ps(one, _mm256_sqrt_ps(len2));
+        __m256 len = _mm256_mul_ps(len2, invLen);
+
+        __m256 stretch = _mm256_mul_ps(k, _mm256_sub_ps(len, rest));
+        __m256 vDotD = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, dx), _mm256_mul_ps(vy, dy)), _mm256_mul_ps(vz, dz));
+        __m256 damping = _mm256_mul_ps(_mm256_mul_ps(dampness, vDotD), invLen);
+        __m256 coef = _mm256_mul_ps(_mm256_sub_ps(zero, _mm256_add_ps(stretch, damping)), invLen);
+
+        _mm256_store_ps(fx, _mm256_mul_ps(coef, dx));
+        _mm256_store_ps(fy, _mm256_mul_ps(coef, dy));
+        _mm256_store_ps(fz, _mm256_mul_ps(coef, dz));
+        _mm256_store_si256(reinterpret_cast<__m256i*>(one_idx), a);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(two_idx), b);
+
+        //springs in a batch can share vertices, so the scatter stays scalar
+        for (int l = 0; l < 8; l++) {
+            glm::vec3 force(fx[l], fy[l], fz[l]);
+            forces[one_idx[l]] += force;
+            forces[two_idx[l]] -= force;
+        }
+    }
+
+    springForceRange(cloth, deltaTime, forces, vectorEnd, count);
+}
+
+
+static bool cpuHasAVX2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    bool osxsave = info[2] & (1 << 27);
+    bool avx = info[2] & (1 << 28);
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) { //os saves ymm registers
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+
+void accumulateSpringForces(const Cloth &cloth, float deltaTime, glm::vec3 *forces) {
+#ifdef SPRING_FORCES_X86
+    static const bool hasAVX2 = cpuHasAVX2();
+    if (hasAVX2) {
+        accumulateSpringForcesAVX2(cloth, deltaTime, forces);
+        return;
+    }
+#endif
+    accumulateSpringForcesScalar(cloth, deltaTime, forces);
+}
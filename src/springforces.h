@@ -0,0 +1,21 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "src/cloth.h"
+
+// Fused hooke + damping spring forces.
+// Each spring is visited once, with a single reciprocal square root for both terms:
+//   d = p1 - p2, invLen = 1/sqrt(dot(d,d)), len = dot(d,d) * invLen
+//   F = -(k * (len - rest) + dampness * dot(v1 - v2, d) * invLen) * invLen * d
+// F is added to vertexOne and subtracted from vertexTwo, in spring order.
+//
+// Compared to the old two-pass loop (glm::length + glm::normalize per pass) the
+// result only differs by float rounding, within about 1e-5 of the force magnitude.
+// The AVX2 kernel performs the same operations in the same order as the scalar
+// kernel, so the two are bit-identical as long as the scalar path is not compiled
+// with FMA contraction.
+
+// picks the AVX2 kernel when the cpu supports it, scalar otherwise
+void accumulateSpringForces(const Cloth &cloth, float deltaTime, glm::vec3 *forces);
+
+void accumulateSpringForcesScalar(const Cloth &cloth, float deltaTime, glm::vec3 *forces);
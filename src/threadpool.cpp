@@ -0,0 +1,170 @@
+#include "threadpool.h"
+#include "utils/allocationcounter.h"
+
+#include <algorithm>
+
+//which pool and queue the current thread works for, workers set this on startup
+static thread_local const ThreadPool *t_pool = nullptr;
+static thread_local int t_queue = 0;
+
+
+ThreadPool::ThreadPool(int threadCount) {
+    if (threadCount <= 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    //the thread calling parallelFor is one of the threads
+    for (int i = 0; i < threadCount; i++) {
+        m_queues.push_back(std::make_unique<TaskQueue>());
+    }
+    for (int i = 1; i < threadCount; i++) {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (std::thread &worker : m_workers) {
+        worker.join();
+    }
+}
+
+
+void ThreadPool::run(int begin, int end, int grainSize, ChunkFn fn, void *context) {
+    Job job{fn, context, grainSize, {end - begin}, AllocationCounter::guarded(), {0}};
+    execute({&job, begin, end});
+
+    //help out until every chunk of this loop is done, the halves we pushed may have been stolen
+    while (job.remaining.load(std::memory_order_acquire) > 0) {
+        Task task;
+        if (findTask(task)) {
+            execute(task);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+
+    AllocationCounter::add(job.allocations.load(std::memory_order_relaxed));
+}
+
+
+void ThreadPool::execute(Task task) {
+    Job *job = task.job;
+
+    while (task.end - task.begin > job->grainSize) {
+        int mid = task.begin + (task.end - task.begin) / 2;
+        if (!push({job, mid, task.end})) {
+            break; //queue is full, run the rest here
+        }
+        task.end = mid;
+    }
+
+    //whichever thread runs the chunk, it runs under the caller's guard and is counted for the caller
+    bool wasGuarded = AllocationCounter::setGuarded(job->guarded);
+    std::size_t allocationsBefore = AllocationCounter::count();
+    job->fn(job->context, task.begin, task.end);
+    std::ptrdiff_t allocations = AllocationCounter::count() - allocationsBefore;
+    AllocationCounter::add(-allocations);
+    job->allocations.fetch_add(allocations, std::memory_order_relaxed);
+    AllocationCounter::setGuarded(wasGuarded);
+
+    //last access to the job, the waiting thread may return as soon as this hits 0
+    job->remaining.fetch_sub(task.end - task.begin, std::memory_order_release);
+}
+
+
+bool ThreadPool::push(const Task &task) {
+    TaskQueue &queue = *m_queues[queueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.bottom - queue.top == queueCapacity) {
+            return false;
+        }
+        queue.tasks[queue.bottom % queueCapacity] = task;
+        queue.bottom++;
+    }
+
+    m_queuedTasks.fetch_add(1);
+    if (m_sleepers.load() > 0) {
+        //a worker between checking m_queuedTasks and waiting would miss the notify without this
+        { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+        m_wake.notify_one();
+    }
+    return true;
+}
+
+
+bool ThreadPool::pop(Task &task) {
+    TaskQueue &queue = *m_queues[queueIndex()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.bottom == queue.top) {
+        return false;
+    }
+    queue.bottom--;
+    task = queue.tasks[queue.bottom % queueCapacity];
+    m_queuedTasks.fetch_sub(1);
+    return true;
+}
+
+
+bool ThreadPool::steal(int victim, Task &task) {
+    TaskQueue &queue = *m_queues[victim];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.bottom == queue.top) {
+        return false;
+    }
+    task = queue.tasks[queue.top % queueCapacity];
+    queue.top++;
+    m_queuedTasks.fetch_sub(1);
+    return true;
+}
+
+
+bool ThreadPool::findTask(Task &task) {
+    if (pop(task)) {
+        return true;
+    }
+
+    int self = queueIndex();
+    int queueCount = m_queues.size();
+    for (int i = 1; i < queueCount; i++) {
+        if (steal((self + i) % queueCount, task)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+int ThreadPool::queueIndex() const {
+    return t_pool == this ? t_queue : 0;
+}
+
+
+void ThreadPool::workerLoop(int index) {
+    t_pool = this;
+    t_queue = index;
+
+    while (true) {
+        Task task;
+        if (findTask(task)) {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleepers.fetch_add(1);
+        m_wake.wait(lock, [this] { return m_stop || m_queuedTasks.load() > 0; });
+        m_sleepers.fetch_sub(1);
+        if (m_stop) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Work stealing thread pool for data parallel loops.
+// parallelFor pushes its range as one task; whoever runs a task keeps splitting it
+// in half, pushing the upper half on its own deque, until it is no bigger than a grain.
+// Idle threads steal the oldest (largest) halves from the other deques.
+// A thread waiting on a loop runs tasks while it waits, so parallelFor can be nested,
+// e.g. from inside another parallelFor. Submitting work does not allocate.
+// In debug builds a task runs under the allocation guard of the thread that started its loop, and the
+// allocations it makes are counted for that thread, see AllocationCounter.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int threadCount = 0); //0 uses every hardware thread
+    ~ThreadPool();
+
+    inline int threadCount() const { return m_workers.size() + 1; }
+
+    //calls fn(chunkBegin, chunkEnd) over [begin, end) in chunks of at most grainSize
+    //ranges no bigger than one grain run inline on the calling thread
+    template <typename F>
+    void parallelFor(int begin, int end, int grainSize, F &&fn);
+
+private:
+    using ChunkFn = void (*)(void *context, int begin, int end);
+
+    //one parallelFor call, lives on the stack of the calling thread
+    struct Job {
+        ChunkFn fn;
+        void *context;
+        int grainSize;
+        std::atomic<int> remaining; //elements not yet processed
+        bool guarded; //the calling thread was inside an AllocationCounter::Guard
+        std::atomic<std::ptrdiff_t> allocations; //made by tasks on any thread, handed to the caller when done
+    };
+
+    struct Task {
+        Job *job;
+        int begin;
+        int end;
+    };
+
+    //fixed size ring, the owner pushes and pops at the bottom, thieves take from the top
+    static const unsigned int queueCapacity = 256;
+    struct TaskQueue {
+        std::mutex mutex;
+        Task tasks[queueCapacity];
+        unsigned int top = 0;
+        unsigned int bottom = 0;
+    };
+
+    void run(int begin, int end, int grainSize, ChunkFn fn, void *context);
+    void execute(Task task);
+    bool push(const Task &task);
+    bool pop(Task &task);
+    bool steal(int victim, Task &task);
+    bool findTask(Task &task);
+    int queueIndex() const;
+    void workerLoop(int index);
+
+    //queue 0 belongs to threads outside the pool, queue i + 1 to worker i
+    std::vector<std::unique_ptr<TaskQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+
+    std::atomic<int> m_queuedTasks{0};
+    std::atomic<int> m_sleepers{0};
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    bool m_stop = false;
+};
+
+
+template <typename F>
+void ThreadPool::parallelFor(int begin, int end, int grainSize, F &&fn) {
+    if (end - begin <= grainSize || m_workers.empty()) {
+        if (begin < end) {
+            fn(begin, end);
+        }
+        return;
+    }
+
+    auto invoke = [](void *context, int chunkBegin, int chunkEnd) {
+        (*static_cast<std::remove_reference_t<F>*>(context))(chunkBegin, chunkEnd);
+    };
+    run(begin, end, std::max(grainSize, 1), invoke, &fn);
+}
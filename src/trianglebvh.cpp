@@ -0,0 +1,93 @@
+#include "trianglebvh.h"
+
+#include <algorithm>
+#include <limits>
+
+
+void TriangleBVH::build(const std::vector<GLuint> &triangleIndices, const std::vector<glm::vec3> &positions) {
+    m_indices = triangleIndices;
+    int triangleCount = m_indices.size() / 3;
+
+    std::vector<glm::vec3> centroids(triangleCount);
+    for (int t = 0; t < triangleCount; t++) {
+        centroids[t] = (positions[m_indices[3*t]] + positions[m_indices[3*t + 1]] + positions[m_indices[3*t + 2]]) / 3.f;
+    }
+
+    m_triangles.resize(triangleCount);
+    for (int t = 0; t < triangleCount; t++) {
+        m_triangles[t] = t;
+    }
+
+    m_nodes.clear();
+    //median splits can leave leaves below leafSize, a binary tree over n triangles has at most 2n - 1 nodes
+    m_nodes.reserve(std::max(1, 2 * triangleCount));
+    if (triangleCount > 0) {
+        buildNode(0, triangleCount, centroids, 0);
+    }
+
+    refit(positions, 0.f);
+}
+
+
+//top down median split along the widest axis of the centroids
+int TriangleBVH::buildNode(int begin, int end, const std::vector<glm::vec3> &centroids, int depth) {
+    int index = m_nodes.size();
+    m_nodes.push_back({glm::vec3(0.f), glm::vec3(0.f), begin, end - begin});
+
+    if (end - begin <= leafSize || depth == maxDepth) {
+        return index;
+    }
+
+    glm::vec3 centroidMin(centroids[m_triangles[begin]]);
+    glm::vec3 centroidMax(centroidMin);
+    for (int k = begin + 1; k < end; k++) {
+        centroidMin = glm::min(centroidMin, centroids[m_triangles[k]]);
+        centroidMax = glm::max(centroidMax, centroids[m_triangles[k]]);
+    }
+
+    glm::vec3 extent = centroidMax - centroidMin;
+    int axis = 0;
+    if (extent.y > extent[axis]) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+
+    int mid = (begin + end) / 2;
+    std::nth_element(m_triangles.begin() + begin, m_triangles.begin() + mid, m_triangles.begin() + end, [&](int a, int b) {
+        return centroids[a][axis] < centroids[b][axis];
+    });
+
+    buildNode(begin, mid, centroids, depth + 1);
+    int right = buildNode(mid, end, centroids, depth + 1);
+
+    m_nodes[index].first = right;
+    m_nodes[index].count = 0;
+    return index;
+}
+
+
+void TriangleBVH::refit(const std::vector<glm::vec3> &positions, float margin) {
+    //children come after their parent, so walking backwards visits them first
+    for (int i = m_nodes.size() - 1; i >= 0; i--) {
+        Node &node = m_nodes[i];
+
+        if (node.count > 0) {
+            node.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+            node.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+            for (int k = node.first; k < node.first + node.count; k++) {
+                int t = m_triangles[k];
+                for (int v = 0; v < 3; v++) {
+                    const glm::vec3 &p = positions[m_indices[3*t + v]];
+                    node.boundsMin = glm::min(node.boundsMin, p);
+                    node.boundsMax = glm::max(node.boundsMax, p);
+                }
+            }
+            node.boundsMin -= glm::vec3(margin);
+            node.boundsMax += glm::vec3(margin);
+        }
+        else {
+            const Node &left = m_nodes[i + 1];
+            const Node &right = m_nodes[node.first];
+            node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+            node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <GL/glew.h>
+
+// bounding volume hierarchy over the cloth triangles, used for triangle level self collision
+// the tree shape is built once per topology, after that only the boxes are refit bottom up
+class TriangleBVH
+{
+public:
+    void build(const std::vector<GLuint> &triangleIndices, const std::vector<glm::vec3> &positions);
+
+    //recomputes every box from the current positions, grown by margin on all sides
+    void refit(const std::vector<glm::vec3> &positions, float margin);
+
+    //calls f(t) for every triangle t whose box overlaps [boxMin, boxMax]
+    template <typename F>
+    void forEachTriangle(const glm::vec3 &boxMin, const glm::vec3 &boxMax, F &&f) const;
+
+private:
+    static const int leafSize = 4;
+    static const int maxDepth = 64;
+
+    //nodes are stored in preorder: the left child of node i is i + 1, so children always come after their parent
+    struct Node {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        int first; //leaf: first entry in m_triangles, inner node: index of the right child
+        int count; //leaf: number of triangles, 0 for inner nodes
+    };
+
+    int buildNode(int begin, int end, const std::vector<glm::vec3> &centroids, int depth);
+
+    std::vector<Node> m_nodes;
+    std::vector<int> m_triangles; //triangle ids, each leaf owns a contiguous range
+    std::vector<GLuint> m_indices; //3 vertex indices per triangle
+};
+
+
+template <typename F>
+void TriangleBVH::forEachTriangle(const glm::vec3 &boxMin, const glm::vec3 &boxMax, F &&f) const {
+    if (m_nodes.empty()) {
+        return;
+    }
+
+    int stack[maxDepth + 2]; //pending right siblings along the path plus the two children
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const Node &node = m_nodes[stack[--stackSize]];
+
+        if (node.boundsMax.x < boxMin.x || node.boundsMax.y < boxMin.y || node.boundsMax.z < boxMin.z
+            || node.boundsMin.x > boxMax.x || node.boundsMin.y > boxMax.y || node.boundsMin.z > boxMax.z) {
+            continue;
+        }
+
+        if (node.count > 0) {
+            for (int k = node.first; k < node.first + node.count; k++) {
+                f(m_triangles[k]);
+            }
+        }
+        else {
+            int self = &node - m_nodes.data();
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = self + 1;
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#include "allocationcounter.h"
+
+#include <cstdlib>
+#include <new>
+
+#ifndef NDEBUG
+
+#ifdef EIGEN_RUNTIME_NO_MALLOC
+#include <Eigen/Core>
+#endif
+
+//plain thread locals, operator new can run before and after anything with a constructor
+static thread_local std::size_t t_allocations = 0;
+static thread_local bool t_guarded = false;
+
+void* operator new(std::size_t size) {
+    t_allocations++;
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+std::size_t AllocationCounter::count() {
+    return t_allocations;
+}
+
+void AllocationCounter::add(std::ptrdiff_t allocations) {
+    t_allocations += allocations;
+}
+
+bool AllocationCounter::guarded() {
+    return t_guarded;
+}
+
+bool AllocationCounter::setGuarded(bool guarded) {
+    bool previous = t_guarded;
+    t_guarded = guarded;
+#ifdef EIGEN_RUNTIME_NO_MALLOC
+    Eigen::internal::set_is_malloc_allowed(!guarded);
+#endif
+    return previous;
+}
+
+#else
+
+std::size_t AllocationCounter::count() {
+    return 0;
+}
+
+void AllocationCounter::add(std::ptrdiff_t) {
+}
+
+bool AllocationCounter::guarded() {
+    return false;
+}
+
+bool AllocationCounter::setGuarded(bool) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+// Debug builds replace the global operator new to count heap allocations per thread. ThreadPool moves
+// what each task allocated onto the thread waiting for its loop, so count() on the thread running a
+// step covers the whole step, nested loops included, and nothing other threads do meanwhile.
+// Eigen allocates through malloc, which operator new does not see. Debug builds define
+// EIGEN_RUNTIME_NO_MALLOC instead, and inside a Guard any Eigen allocation asserts, including in pool
+// tasks started from inside it.
+// Release builds (NDEBUG) leave the allocator alone, count() is always 0 and Guard does nothing.
+namespace AllocationCounter {
+    std::size_t count(); //allocations by the calling thread, plus those of pool tasks it waited for
+    void add(std::ptrdiff_t allocations); //for ThreadPool, moves a task's count to the thread waiting on it
+
+    bool guarded(); //whether the calling thread is inside a Guard
+    bool setGuarded(bool guarded); //for ThreadPool, runs a task under its loop's guard, returns the previous state
+
+    //heap allocations by Eigen on this thread, or in pool tasks started from it, assert while this lives
+    class Guard {
+    public:
+        Guard() : m_wasGuarded(setGuarded(true)) {}
+        ~Guard() { setGuarded(m_wasGuarded); }
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+
+    private:
+        bool m_wasGuarded;
+    };
+}
@@ -8,9 +8,36 @@
 #include <QFile>
 #include <QTextStream>
 #include <iostream>
+#include <string>
+
+// A linked program. It keeps no uniform locations itself: location() asks the driver on every call, so it is
+// meant for setup. Whoever draws with the program resolves the locations it needs once after linking and keeps them.
+struct ShaderProgram {
+    GLuint id = 0;
+
+    // Queries the driver, -1 for uniforms the program does not have or the compiler optimized away, which glUniform* ignores
+    GLint location(const char *name) const {
+        return glGetUniformLocation(id, name);
+    }
+};
 
 class ShaderLoader{
 public:
+    // Binding point of the Camera uniform block (view, projection and their product) shared by every program.
+    static const GLuint cameraBlockBinding = 0;
+
+    static ShaderProgram createProgram(const char * vertex_file_path, const char * fragment_file_path){
+        ShaderProgram program;
+        program.id = createShaderProgram(vertex_file_path, fragment_file_path);
+
+        GLuint cameraBlock = glGetUniformBlockIndex(program.id, "Camera");
+        if (cameraBlock != GL_INVALID_INDEX) {
+            glUniformBlockBinding(program.id, cameraBlock, cameraBlockBinding);
+        }
+
+        return program;
+    }
+
     static GLuint createShaderProgram(const char * vertex_file_path, const char * fragment_file_path){
         // Create and compile the shaders.
         GLuint vertexShaderID = createShader(GL_VERTEX_SHADER, vertex_file_path);